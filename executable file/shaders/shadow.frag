@@ -0,0 +1,19 @@
+#version 120
+// Adds the sun to the lighting from shadow.vert where the shadow map
+// doesn't have anything between this pixel and the sun.
+
+uniform sampler2DShadow shadowMap;
+uniform bool useShadow;
+
+varying vec3 litColor;
+varying vec3 sunColor;
+varying vec4 shadowCoord;
+
+void main()
+{
+	// one tap, the linear filtered compare already blends 2x2 texels
+	float sunVisibility = 1.0;
+	if (useShadow)
+		sunVisibility = shadow2DProj(shadowMap, shadowCoord).r;
+	gl_FragColor = vec4(clamp(litColor + sunColor * sunVisibility, 0.0, 1.0), gl_Color.a);
+}
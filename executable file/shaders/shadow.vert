@@ -0,0 +1,68 @@
+#version 120
+// The fixed function lights (glColorMaterial ambient and diffuse, no
+// specular) evaluated per vertex like the rest of the program. Light 0 is
+// the sun, its share is passed on separately so shadow.frag can scale it
+// by what the shadow map says reaches each pixel.
+
+uniform mat4 eyeToShadow;
+uniform bool lighting;
+uniform bool lightOn[4];
+
+varying vec3 litColor;
+varying vec3 sunColor;
+varying vec4 shadowCoord;
+
+void main()
+{
+	vec4 eyePos = gl_ModelViewMatrix * gl_Vertex;
+	shadowCoord = eyeToShadow * eyePos;
+	gl_Position = ftransform();
+	gl_FrontColor = gl_Color;
+
+	if (!lighting) {
+		litColor = gl_Color.rgb;
+		sunColor = vec3(0.0);
+		return;
+	}
+
+	// GL_NORMALIZE is off in this program, so keep the length scaled
+	// models give their normals just like the fixed function pipeline
+	vec3 normal = gl_NormalMatrix * gl_Normal;
+	vec3 ambient = gl_LightModel.ambient.rgb;
+	vec3 diffuse = vec3(0.0);
+	vec3 sunDiffuse = vec3(0.0);
+	for (int i = 0; i < 4; i++) {
+		if (!lightOn[i])
+			continue;
+
+		vec3 toLight;
+		float attenuation = 1.0;
+		if (gl_LightSource[i].position.w == 0.0) {
+			toLight = normalize(gl_LightSource[i].position.xyz);
+		}
+		else {
+			toLight = gl_LightSource[i].position.xyz - eyePos.xyz;
+			float dist = length(toLight);
+			toLight = toLight / dist;
+			attenuation = 1.0 / (gl_LightSource[i].constantAttenuation +
+				gl_LightSource[i].linearAttenuation * dist +
+				gl_LightSource[i].quadraticAttenuation * dist * dist);
+			if (gl_LightSource[i].spotCutoff <= 90.0) {
+				float spot = dot(-toLight, normalize(gl_LightSource[i].spotDirection));
+				if (spot < gl_LightSource[i].spotCosCutoff)
+					attenuation = 0.0;
+				else
+					attenuation *= pow(spot, gl_LightSource[i].spotExponent);
+			}
+		}
+
+		float lambert = max(dot(normal, toLight), 0.0);
+		ambient += attenuation * gl_LightSource[i].ambient.rgb;
+		if (i == 0)
+			sunDiffuse = attenuation * lambert * gl_LightSource[i].diffuse.rgb;
+		else
+			diffuse += attenuation * lambert * gl_LightSource[i].diffuse.rgb;
+	}
+	litColor = gl_Color.rgb * (ambient + diffuse);
+	sunColor = gl_Color.rgb * sunDiffuse;
+}
@@ -22,10 +22,12 @@
 
 #include <time.h>
 #include <math.h>
+#include <string.h>
 
 #include "TrainWindow.H"
 #include "TrainView.H"
 #include "CallBacks.H"
+#include "trackedit.h"
 
 #pragma warning(push)
 #pragma warning(disable:4312)
@@ -41,12 +43,14 @@
 void resetCB(Fl_Widget*, TrainWindow* tw)
 //===========================================================================
 {
+	// undoable like any other edit
+	std::vector<ControlPoint> oldPoints = tw->m_Track.points;
 	tw->m_Track.resetPoints();
-	tw->trainView->selectedCube = -1;
+	tw->trainView->selectPoint(-1, false);
 	tw->m_Track.trainU = 0;
-	tw->trainView->updateTrackSpline();
-	tw->trainView->trainReset();
-	tw->trainView->trainMove(0);
+	TrackEdit edit(tw->trainView);
+	edit.replaced(oldPoints);
+	edit.commit(true);
 	tw->damageMe();
 }
 
@@ -76,7 +80,10 @@ void addPointCB(Fl_Widget*, TrainWindow* tw)
 	size_t previdx = (newidx + npts -1) % npts;
 	Pnt3f npos = (tw->m_Track.points[previdx].pos + tw->m_Track.points[newidx].pos) * .5f;
 
-	tw->m_Track.points.insert(tw->m_Track.points.begin() + newidx,npos);
+	TrackEdit edit(tw->trainView);
+	edit.insert((unsigned int)newidx, ControlPoint(npos));
+	// the points after it moved up one, select just the new one
+	tw->trainView->selectPoint((int)newidx, false);
 
 	// make it so that the train doesn't move - unless its affected by this control point
 	// it should stay between the same points
@@ -85,8 +92,7 @@ void addPointCB(Fl_Widget*, TrainWindow* tw)
 		if (tw->m_Track.trainU >= npts) tw->m_Track.trainU -= npts;
 	}
 
-	tw->trainView->updateTrackSpline();
-	tw->trainView->trainMove(0);
+	edit.commit();
 	tw->damageMe();
 }
 
@@ -97,15 +103,18 @@ void addPointCB(Fl_Widget*, TrainWindow* tw)
 void deletePointCB(Fl_Widget*, TrainWindow* tw)
 //===========================================================================
 {
+	TrackEdit edit(tw->trainView);
 	if (tw->m_Track.points.size() > 4) {
-		if (tw->trainView->selectedCube >= 0) {
-			tw->m_Track.points.erase(tw->m_Track.points.begin() + tw->trainView->selectedCube);
+		// the selected points from the back, keeping at least 4
+		std::vector<unsigned int>& selected = tw->trainView->selectedPoints;
+		if (!selected.empty()) {
+			for (size_t i = selected.size(); i > 0 && tw->m_Track.points.size() > 4; i--)
+				edit.erase(selected[i - 1]);
 		} else
-			tw->m_Track.points.pop_back();
+			edit.erase((unsigned int)tw->m_Track.points.size() - 1);
+		tw->trainView->selectPoint(-1, false);
 	}
-	tw->trainView->updateTrackSpline();
-	tw->trainView->trainReset();
-	tw->trainView->trainMove(0);
+	edit.commit(true);
 	tw->damageMe();
 }
 //***************************************************************************
@@ -160,12 +169,30 @@ void loadCB(Fl_Widget*, TrainWindow* tw)
 //===========================================================================
 {
 	const char* fname = 
-		fl_file_chooser("Pick a Track File","*.txt","TrackFiles/");
-	if (fname) {
-		tw->m_Track.readPoints(fname);
-		tw->trainView->updateTrackSpline();
-		tw->trainView->trainReset();
-		tw->trainView->trainMove(0.0f);
+		fl_file_chooser("Pick a Track File","*.{txt,glb,bundle}","TrackFiles/");
+	size_t length = fname ? strlen(fname) : 0;
+	if (length > 7 && strcmp(fname + length - 7, ".bundle") == 0) {
+		// baked offline, nothing to build
+		TrackParseError error;
+		if (!tw->trainView->loadBundle(fname, error))
+			fl_alert("Can't load %s: %s", fname, error.message.c_str());
+		tw->damageMe();
+	}
+	else if (fname) {
+		std::vector<ControlPoint> oldPoints = tw->m_Track.points;
+		TrackParseError error;
+		if (!tw->m_Track.readPoints(fname, error)) {
+			if (error.line > 0)
+				fl_alert("%s, line %u column %u: %s", fname, error.line, error.column, error.message.c_str());
+			else
+				fl_alert("Can't load %s: %s", fname, error.message.c_str());
+			return;
+		}
+		tw->trainView->resetBakeSettings();
+		tw->trainView->selectPoint(-1, false);
+		TrackEdit edit(tw->trainView);
+		edit.replaced(oldPoints);
+		edit.commit(true);
 		tw->damageMe();
 	}
 }
@@ -177,30 +204,29 @@ void saveCB(Fl_Widget*, TrainWindow* tw)
 //===========================================================================
 {
 	const char* fname = 
-		fl_input("File name for save (should be *.txt)","TrackFiles/");
-	if (fname)
-		tw->m_Track.writePoints(fname);
+		fl_input("File name for save (*.txt, or *.glb for glTF)","TrackFiles/");
+	if (!fname)
+		return;
+	size_t length = strlen(fname);
+	if (length > 4 && strcmp(fname + length - 4, ".glb") == 0) {
+		// the meshes as they are drawn now, so this one is written right away
+		if (!tw->trainView->exportTrack(fname))
+			fl_alert("Can't write %s", fname);
+	}
+	else
+		// written on the saver thread, the window doesn't wait for it
+		tw->trainView->saveTrack(fname);
 }
 
 //***************************************************************************
 //
-// * Rotate the selected control point about x axis
+// * Rotate the selected control points about x axis
 //===========================================================================
 void rollx(TrainWindow* tw, float dir)
 {
-	int s = tw->trainView->selectedCube;
-	if (s >= 0) {
-		Pnt3f old = tw->m_Track.points[s].orient;
-		float si = sin(((float)M_PI_4) * dir);
-		float co = cos(((float)M_PI_4) * dir);
-		tw->m_Track.points[s].orient.y = co * old.y - si * old.z;
-		tw->m_Track.points[s].orient.z = si * old.y + co * old.z;
-	}
-
-	tw->trainView->updateTrackSpline();
-	tw->trainView->trainReset();
-	tw->trainView->trainMove(0.0f);
-	tw->damageMe();
+	TrackEdit edit(tw->trainView);
+	edit.roll(tw->trainView->selectedPoints, ((float)M_PI_4) * dir, glm::vec3(1.0f, 0.0f, 0.0f));
+	edit.commit();
 } 
 
 //***************************************************************************
@@ -224,27 +250,15 @@ void rmxCB(Fl_Widget*, TrainWindow* tw)
 
 //***************************************************************************
 //
-// * Rotate the selected control point  about z axis
+// * Rotate the selected control points  about z axis
 //===========================================================================
 void rollz(TrainWindow* tw, float dir)
 //===========================================================================
 {
-	int s = tw->trainView->selectedCube;
-	if (s >= 0) {
-
-		Pnt3f old = tw->m_Track.points[s].orient;
-
-		float si = sin(((float)M_PI_4) * dir);
-		float co = cos(((float)M_PI_4) * dir);
-
-		tw->m_Track.points[s].orient.y = co * old.y - si * old.x;
-		tw->m_Track.points[s].orient.x = si * old.y + co * old.x;
-	}
-
-	tw->trainView->updateTrackSpline();
-	tw->trainView->trainReset();
-	tw->trainView->trainMove(0.0f);
-	tw->damageMe();
+	// x toward y is the negative turn about z
+	TrackEdit edit(tw->trainView);
+	edit.roll(tw->trainView->selectedPoints, -((float)M_PI_4) * dir, glm::vec3(0.0f, 0.0f, 1.0f));
+	edit.commit();
 }
 
 //***************************************************************************
@@ -269,9 +283,9 @@ void rmzCB(Fl_Widget*, TrainWindow* tw)
 
 void splineChangedCB(Fl_Widget*, TrainWindow* tw)
 {
-	tw->trainView->updateTrackSpline();
-	tw->trainView->trainReset();
-	tw->trainView->trainMove(0.0f);
+	// a bundle's settings were for its own spline type
+	tw->trainView->resetBakeSettings();
+	tw->trainView->requestTrackSpline(true);
 	tw->damageMe();
 }
 
@@ -283,19 +297,13 @@ void carNumChange(Fl_Widget*, TrainWindow* tw) {
 }
 
 void trainViewRedraw(Fl_Widget*, TrainWindow* tw) {
-	tw->trainView->damage(1);
+	tw->trainView->redrawScheduler.invalidate();
 }
 
 void physicsButtonCB(Fl_Widget*, TrainWindow* tw) {
 }
 
-void runTimerCB(TrainWindow* tw) {
-	Fl::repeat_timeout((double)1/40, (Fl_Timeout_Handler)runTimerCB, (void*)tw);
-	if (tw->runButton->value()) {
-		float deltaTime = (float)(clock() - lastRedraw) / 1000.0f;
-		lastRedraw = clock();
-		tw->advanceTrain(1, 0, deltaTime);
-		tw->damageMe();
-	}
-	lastRedraw = clock();
-}
\ No newline at end of file
+// the simulation thread moves the train while the run button is down
+void runCB(Fl_Widget*, TrainWindow* tw) {
+	tw->pushSimControls();
+}
@@ -25,15 +25,18 @@
 *************************************************************************/
 
 #include "Track.H"
+#include "atomicfile.h"
+#include "trackgltf.h"
 
 #include <FL/fl_ask.h>
+#include <string.h>
 
 //****************************************************************************
 //
 // * Constructor
 //============================================================================
 CTrack::
-CTrack() : trainU(0)
+CTrack() : trainU(0), revision(0)
 //============================================================================
 {
 	resetPoints();
@@ -53,6 +56,7 @@ resetPoints()
 	points.push_back(ControlPoint(Pnt3f(0,5,50)));
 	points.push_back(ControlPoint(Pnt3f(-50,5,0)));
 	points.push_back(ControlPoint(Pnt3f(0,5,-50)));
+	touch();
 
 	// we had better put the train back at the start of the track...
 	trainU = 0.0;
@@ -60,119 +64,67 @@ resetPoints()
 
 //****************************************************************************
 //
-// * Handy utility to break a string into a list of words
+// * The file format is simple
+//   first line: an integer with the number of control points
+//	  other lines: one line per control point
+//   either 3 (X,Y,Z) numbers on the line, or 6 numbers (X,Y,Z, orientation)
+//   .glb files are glTF exports of a track (see TrackGltf)
 //============================================================================
-void breakString(char* str, std::vector<const char*>& words) 
+bool CTrack::
+readPoints(const char* filename, TrackParseError& error)
 //============================================================================
 {
-	// start with no words
-	words.clear();
-
-	// scan through the string, starting at the beginning
-	char* p = str;
-
-	// stop when we hit the end of the string
-	while(*p) {
-		// skip over leading whitespace - stop at the first character or end of string
-		while (*p && *p<=' ') p++;
-
-		// now we're pointing at the first thing after the spaces
-		// make sure its not a comment, and that we're not at the end of the string
-		// (that's actually the same thing)
-		if (! (*p) || *p == '#')
-		break;
-
-		// so we're pointing at a word! add it to the word list
-		words.push_back(p);
+	size_t length = strlen(filename);
+	bool gltf = length > 4 && strcmp(filename + length - 4, ".glb") == 0;
+	if (gltf ? !TrackGltf::read(filename, points, error) : !parser.read(filename, points, error))
+		return false;
+	touch();
 
-		// now find the end of the word
-		while(*p > ' ') p++;	// stop at space or end of string
-
-		// if its ethe end of the string, we're done
-		if (! *p) break;
-
-		// otherwise, turn this space into and end of string (to end the word)
-		// and keep going
-		*p = 0;
-		p++;
-	}
+	// a new track starts the train over
+	trainU = 0;
+	return true;
 }
 
 //****************************************************************************
 //
-// * The file format is simple
-//   first line: an integer with the number of control points
-//	  other lines: one line per control point
-//   either 3 (X,Y,Z) numbers on the line, or 6 numbers (X,Y,Z, orientation)
+// * write the control points to our simple format
 //============================================================================
 void CTrack::
-readPoints(const char* filename)
+writePoints(const char* filename)
 //============================================================================
 {
-	FILE* fp = fopen(filename,"r");
-	if (!fp) {
-		fl_alert("Can't Open File!\n");
-	} 
-	else {
-		char buf[512];
-
-		// first line = number of points
-		fgets(buf,512,fp);
-		size_t npts = (size_t) atoi(buf);
-
-		if( (npts<4) || (npts>65535)) {
-			fl_alert("Illegal Number of Points Specified in File");
-		} else {
-			points.clear();
-			// get lines until EOF or we have enough points
-			while( (points.size() < npts) && fgets(buf,512,fp) ) {
-				Pnt3f pos,orient;
-				vector<const char*> words;
-				breakString(buf,words);
-				if (words.size() >= 3) {
-					pos.x = (float) strtod(words[0],0);
-					pos.y = (float) strtod(words[1],0);
-					pos.z = (float) strtod(words[2],0);
-				} else {
-					pos.x=0;
-					pos.y=0;
-					pos.z=0;
-				}
-				if (words.size() >= 6) {
-					orient.x = (float) strtod(words[3],0);
-					orient.y = (float) strtod(words[4],0);
-					orient.z = (float) strtod(words[5],0);
-				} else {
-					orient.x = 0;
-					orient.y = 1;
-					orient.z = 0;
-				}
-				orient.normalize();
-				points.push_back(ControlPoint(pos,orient));
-			}
-		}
-		fclose(fp);
-	}
-	trainU = 0;
+	if (!writePoints(filename, points))
+		fl_alert("Can't open file for writing");
 }
 
 //****************************************************************************
 //
-// * write the control points to our simple format
+// * the same for any list of points, safe to call from any thread.
+//   the file is replaced in one step once it is completely written, a
+//   crash on the way leaves the old one
+//============================================================================
+bool CTrack::
+writePoints(const char* filename, const vector<ControlPoint>& points)
+//============================================================================
+{
+	AtomicFile file;
+	if (!file.open(filename)) return false;
+	FILE* fp = file.stream();
+	fprintf(fp,"%d\n",(int)points.size());
+	for(size_t i=0; i<points.size(); ++i)
+		fprintf(fp,"%g %g %g %g %g %g\n",
+			points[i].pos.x, points[i].pos.y, points[i].pos.z, 
+			points[i].orient.x, points[i].orient.y, points[i].orient.z);
+	return file.commit();
+}
+
+//****************************************************************************
+//
+// * note a change to the points
 //============================================================================
 void CTrack::
-writePoints(const char* filename)
+touch()
 //============================================================================
 {
-	FILE* fp = fopen(filename,"w");
-	if (!fp) {
-		fl_alert("Can't open file for writing");
-	} else {
-		fprintf(fp,"%d\n",points.size());
-		for(size_t i=0; i<points.size(); ++i)
-			fprintf(fp,"%g %g %g %g %g %g\n",
-				points[i].pos.x, points[i].pos.y, points[i].pos.z, 
-				points[i].orient.x, points[i].orient.y, points[i].orient.z);
-		fclose(fp);
-	}
+	revision++;
 }
@@ -25,7 +25,11 @@
 *************************************************************************/
 #include <iomanip> 
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
 #include <Fl/fl.h>
+#include <FL/fl_ask.h>
 
 // we will need OpenGL, and OpenGL needs windows.h
 #include <windows.h>
@@ -37,6 +41,10 @@
 #include "TrainView.H"
 #include "TrainWindow.H"
 #include "Utilities/3DUtils.H"
+#include "modelcache.h"
+#include "trackedit.h"
+#include "trackgltf.h"
+#include "allocationcheck.h"
 
 
 #ifdef EXAMPLE_SOLUTION
@@ -44,47 +52,211 @@
 #endif
 
 
+//************************************************************************
+//
+// * The worker threads wake up the FlTk loop with a token of the view, not
+//   the view itself: an awake still queued when the view is destroyed can't
+//   be taken back, its callback finds no live view for the token and does
+//   nothing
+//========================================================================
+static TrainView* liveView = NULL;
+static uintptr_t liveToken = 0;
+static TrainView* viewOf(void* token)
+{
+	if (liveView == NULL || (uintptr_t)token != liveToken) return NULL;
+	return liveView;
+}
+
+//************************************************************************
+//
+// * Model loading happens on worker threads. When a file is done the worker
+//   wakes up the FlTk loop, which publishes the mesh on the UI thread
+//========================================================================
+static void publishModelsCB(void* token)
+{
+	TrainView* view = viewOf(token);
+	if (view == NULL) return;
+	if (ModelCache::global().publish() > 0) {
+		view->sceneRevision++;
+		view->trackRevision++;
+		view->redrawScheduler.invalidate();
+	}
+}
+static void modelReadyCB(void* token)
+{
+	Fl::awake(publishModelsCB, token);
+}
+
+//************************************************************************
+//
+// * Same for the track: the builder thread wakes up the FlTk loop and the
+//   new track is swapped in on the UI thread
+//========================================================================
+static void publishTrackCB(void* token)
+{
+	TrainView* view = viewOf(token);
+	if (view != NULL) view->publishTrackSpline();
+}
+static void trackReadyCB(void* token)
+{
+	Fl::awake(publishTrackCB, token);
+}
+
+//************************************************************************
+//
+// * The simulation thread published a tick: pass the widgets on to it
+//   and draw the new snapshot
+//========================================================================
+static void simulationTickCB(void* token)
+{
+	TrainView* view = viewOf(token);
+	if (view == NULL) return;
+	view->tw->pushSimControls();
+	view->redrawScheduler.invalidate();
+}
+static void simulationReadyCB(void* token)
+{
+	Fl::awake(simulationTickCB, token);
+}
+
+//************************************************************************
+//
+// * Every so often the points go to the autosave file if they changed,
+//   written on the saver thread; its results come back through the loop
+//========================================================================
+static void autosaveCB(void* view)
+{
+	((TrainView*)view)->autosave();
+	Fl::repeat_timeout(((TrainView*)view)->autosaveInterval, autosaveCB, view);
+}
+static void reportSavesCB(void* token)
+{
+	TrainView* view = viewOf(token);
+	if (view != NULL) view->reportSaves();
+}
+static void trackSavedCB(void* token)
+{
+	Fl::awake(reportSavesCB, token);
+}
+
+// trees around the track, hidden when the track runs through them
+static const glm::vec3 treesPositions[] = {	glm::vec3(-83.0f, 0.0f, 37.0f),
+									glm::vec3(-62.0f, 0.0f, -69.0f),
+									glm::vec3(-27.0f, 0.0f, 24.0f),
+									glm::vec3(-4.0f, 0.0f, 0.0f),
+									glm::vec3(2.0f, 0.0f, 83.0f),
+									glm::vec3(13.0f, 0.0f, -72.0f),
+									glm::vec3(21.0f, 0.0f, 53.0f),
+									glm::vec3(39.0f, 0.0f, 46.0f),
+									glm::vec3(55.0f, 0.0f, 95.0f),
+									glm::vec3(74.0f, 0.0f, 28.0f),
+};
+static const float treesRotations[] = { 0, 40, 35, 86, 12, 138, 264, 237, 186, 311};
+
 //************************************************************************
 //
 // * Constructor to set up the GL window
 //========================================================================
 TrainView::
 TrainView(int x, int y, int w, int h, const char* l) 
-	: Fl_Gl_Window(x,y,w,h,l)
+	: Fl_Gl_Window(x,y,w,h,l), redrawScheduler(this)
 //========================================================================
 {
 	mode( FL_RGB|FL_ALPHA|FL_DOUBLE | FL_STENCIL );
 	
 	resetArcball();
 
-	trainModel = new ModelClass("models/train.obj");
+	liveView = this;
+	liveToken++;
+	void* token = (void*)liveToken;
+
+	// the models are parsed on the loader threads, until then they draw
+	// nothing and the window can show up right away
+	ModelCache::global().setReadyCallback(modelReadyCB, token);
+	trainModel = new ModelClass();
+	trainModel->loadObjFileAsync("models/train.obj");
 	trainModel->setColor(32, 32, 64);
-	headlightModel = new ModelClass("models/headLight.obj");
+	headlightModel = new ModelClass();
+	headlightModel->loadObjFileAsync("models/headLight.obj");
 	headlightModel->setColor(16, 16, 16);
-	carModel = new ModelClass("models/car.obj");
+	carModel = new ModelClass();
+	carModel->loadObjFileAsync("models/car.obj");
 	carModel->setColor(32, 64, 64);
 	carModel->setInstanceNum(0);
-	sleeperModel = new ModelClass("models/sleeper.obj");
+	sleeperModel = new ModelClass();
+	sleeperModel->loadObjFileAsync("models/sleeper.obj");
 	sleeperModel->setColor(12, 12, 6);
 	trackModel = new ModelClass();
-	trainControl = new CaronTrack(trainModel);
-	treeAModel = new ModelClass("models/tree_a.obj");
+	supportModel = new ModelClass();
+	simulation.setReadyCallback(simulationReadyCB, token);
+	treeAModel = new ModelClass();
+	treeAModel->loadObjFileAsync("models/tree_a.obj");
 	treeAModel->setInstanceNum(0);
 
-	const char smokeFrameFiles[][80] = { "models/smoke_0.obj", "models/smoke_1.obj" , "models/smoke_2.obj" , "models/smoke_3.obj" , "models/smoke_4.obj" , "models/smoke_5.obj" };
-	for (unsigned int i = 0; i < 6; i++) {
-		ModelClass* newFrame = new ModelClass(smokeFrameFiles[i]);
-		newFrame->setColor(32, 32, 32);
-		smokeFrames.push_back(newFrame);
-	}
-	const float smokeFrameDelaysVal[] = { 0.2, 0.2, 0.5, 0.5, 0.5, 0.5 };
-	std::vector<float> smokeFrameDelays(smokeFrameDelaysVal, smokeFrameDelaysVal + sizeof(smokeFrameDelaysVal)/sizeof(float));
-	smokeAnimation = new Animation(smokeFrames, smokeFrameDelays);
-	//smokeAnimation->initTransforms(1);
-
-	trackWidth = 5.0f;
+	smokeParticles = new ParticleSystem(256);
+	smokeParticles->color = glm::u8vec3(32, 32, 32);
+	cameraRight = glm::vec3(1.0f, 0.0f, 0.0f);
+	cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
+
+	// created on the first frame that asks for it, it needs the GL context
+	shadowMap = new ShadowMap(2048, 160.0f);
+	sceneRevision = 0;
+	trackRevision = 0;
+	chunkRevision = 0;
+	checkedTrackRevision = (unsigned long)-1;
+	frameTiming = false;
+	frameTimeShadowMapped = false;
+	frameTimeSum = 0.0;
+	frameTimeNum = 0;
+
+	resetBakeSettings();
+	trackStreamSamples = 200000;
+	trackResetPending = false;
+	trackBuilder.setReadyCallback(trackReadyCB, token);
 
 	selectedCube = -1;
+	selectionRevision = 0;
+	dragEdit = 0;
+	regionSelecting = false;
+	regionLasso = false;
+	lastPick.kind = -1;
+
+	autosaveFile = "TrackFiles/autosave.txt";
+	autosaveInterval = 30.0;
+	autosavedRevision = 0;
+	autosaveFailed = false;
+	trackSaver.setDoneCallback(trackSavedCB, token);
+	Fl::add_timeout(autosaveInterval, autosaveCB, this);
+}
+
+//************************************************************************
+//
+// * Release the models - meshes loaded from files are freed once the
+//   last model using them is gone
+//========================================================================
+TrainView::
+~TrainView()
+//========================================================================
+{
+	// wakeups still queued for this view are dropped from here on
+	liveView = NULL;
+	ModelCache::global().stop();
+	simulation.stop();
+	Fl::remove_timeout(autosaveCB, this);
+	// the saves still queued are written, nobody hears about them
+	trackSaver.setDoneCallback(NULL, NULL);
+	trackSaver.stop();
+
+	delete trainModel;
+	delete headlightModel;
+	delete carModel;
+	delete sleeperModel;
+	delete trackModel;
+	delete supportModel;
+	delete treeAModel;
+	delete smokeParticles;
+	delete shadowMap;
+	ModelCache::global().purge();
 }
 
 //************************************************************************
@@ -115,9 +287,14 @@ int TrainView::handle(int event)
 	// see if the ArcBall will handle the event - if it does, 
 	// then we're done
 	// note: the arcball only gets the event if we're in world view
+	// the arcball damages the window on every mouse event, let the
+	// scheduler fold those into the next frame instead
 	if (tw->worldCam->value())
-		if (arcball.handle(event)) 
+		if (arcball.handle(event)) {
+			clear_damage();
+			redrawScheduler.invalidate();
 			return 1;
+		}
 
 	// remember what button was used
 	static int last_push;
@@ -128,23 +305,51 @@ int TrainView::handle(int event)
 			last_push = Fl::event_button();
 			// if the left button be pushed is left mouse button
 			if (last_push == FL_LEFT_MOUSE  ) {
+				bool add = (Fl::event_state() & FL_SHIFT) != 0;
+				dragEdit++;
 				doPick();
-				damage(1);
+				if (selectedCube >= 0) {
+					// shift adds to (or takes from) the selection, a point
+					// outside the selection starts a new one
+					if (add || !isSelected(selectedCube))
+						selectPoint(selectedCube, add);
+				}
+				else {
+					// on nothing: drag out a box, or a lasso with ctrl
+					if (!add) selectPoint(-1, false);
+					regionSelecting = true;
+					regionLasso = (Fl::event_state() & FL_CTRL) != 0;
+					selectRegion.assign(2, glm::vec2((float)Fl::event_x(), (float)(h() - Fl::event_y())));
+				}
+				redrawScheduler.invalidate();
 				return 1;
 			};
 			break;
 
 	   // Mouse button release event
 		case FL_RELEASE: // button release
-			damage(1);
+			if (regionSelecting) {
+				regionSelecting = false;
+				selectInRegion(selectRegion, true);
+				redrawScheduler.invalidate();
+			}
 			last_push = 0;
 			return 1;
 
 		// Mouse button drag event
 		case FL_DRAG:
 
+			if ((last_push == FL_LEFT_MOUSE) && regionSelecting) {
+				glm::vec2 mouse((float)Fl::event_x(), (float)(h() - Fl::event_y()));
+				// a box keeps its two corners, a lasso every few pixels
+				if (!regionLasso)
+					selectRegion[1] = mouse;
+				else if (glm::length(mouse - selectRegion.back()) >= 3.0f)
+					selectRegion.push_back(mouse);
+				redrawScheduler.invalidate();
+			}
 			// Compute the new control point position
-			if ((last_push == FL_LEFT_MOUSE) && (selectedCube >= 0)) {
+			else if ((last_push == FL_LEFT_MOUSE) && (selectedCube >= 0)) {
 				ControlPoint* cp = &m_pTrack->points[selectedCube];
 
 				double r1x, r1y, r1z, r2x, r2y, r2z;
@@ -158,14 +363,11 @@ int TrainView::handle(int event)
 								rx, ry, rz,
 								(Fl::event_state() & FL_CTRL) != 0);
 
-				cp->pos.x = (float) rx;
-				cp->pos.y = (float) ry;
-				cp->pos.z = (float) rz;
-
-				updateTrackSpline();
-				trainReset();
-				trainMove(0.0f);
-				damage(1);
+				// the whole selection moves with the point under the mouse,
+				// as one edit and one rebuild. the whole drag is one undo step
+				TrackEdit edit(this, dragEdit);
+				edit.translate(selectedPoints, glm::vec3((float)rx - cp->pos.x, (float)ry - cp->pos.y, (float)rz - cp->pos.z));
+				edit.commit();
 			}
 			break;
 
@@ -197,6 +399,43 @@ int TrainView::handle(int event)
 
 					return 1;
 				};
+				// the selection as a group: '[' and ']' turn it about its
+				// center, '-' and '=' shrink and grow it, 'a' selects everything
+				if ((k == '[' || k == ']' || k == '-' || k == '=') && !selectedPoints.empty()) {
+					TrackEdit edit(this);
+					if (k == '[' || k == ']')
+						edit.rotate(selectedPoints, glm::radians((k == '[') ? -15.0f : 15.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+					else
+						edit.scale(selectedPoints, (k == '-') ? 1.0f / 1.1f : 1.1f);
+					edit.commit();
+					return 1;
+				};
+				// ctrl-z undoes, ctrl-y (or ctrl-shift-z) redoes
+				if ((ks & FL_CTRL) && (k == 'z' || k == 'y')) {
+					if (k == 'y' || (ks & FL_SHIFT))
+						redoEdit();
+					else
+						undoEdit();
+					return 1;
+				};
+				if (k == 'a') {
+					selectedPoints.clear();
+					for (unsigned int i = 0; i < m_pTrack->points.size(); i++)
+						selectedPoints.push_back(i);
+					if (selectedCube < 0 && !selectedPoints.empty()) selectedCube = 0;
+					selectionRevision++;
+					redrawScheduler.invalidate();
+					return 1;
+				};
+				if (k == 't') {
+					// time whole frames (with glFinish) for comparing the shadow paths
+					frameTiming = !frameTiming;
+					frameTimeSum = 0.0;
+					frameTimeNum = 0;
+					printf("Frame timing %s\n", frameTiming ? "on" : "off");
+					redrawScheduler.invalidate();
+					return 1;
+				};
 				break;
 	}
 
@@ -223,6 +462,14 @@ void TrainView::draw()
 	}
 	else
 		throw std::runtime_error("Could not initialize GLAD!");
+	std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+	redrawScheduler.frameStarted();
+	if (simulation.acquire())
+		applySnapshot(simulation.snapshot());
+	// once the track and the shadow map are built, a frame only moves the
+	// train and must not allocate (debug builds check it)
+	AllocationCheck frameCheck("TrainView::draw");
+	bool steadyFrame = listRevision() == checkedTrackRevision && (!tw->shadowMapButton->value() || shadowMap->isCreated());
 
 	// Set up the view port
 	glViewport(0,0,w(),h());
@@ -244,6 +491,16 @@ void TrainView::draw()
 	glLoadIdentity();
 	setProjection();		// put the code to set up matrices here
 
+	// the first two rows of projection * modelview are the camera axes
+	// (the train view puts its lookAt into the projection matrix)
+	glm::mat4 projectionMat, modelviewMat;
+	glGetFloatv(GL_PROJECTION_MATRIX, glm::value_ptr(projectionMat));
+	glGetFloatv(GL_MODELVIEW_MATRIX, glm::value_ptr(modelviewMat));
+	glm::mat4 viewProj = projectionMat * modelviewMat;
+	cameraRight = glm::normalize(glm::vec3(viewProj[0][0], viewProj[1][0], viewProj[2][0]));
+	cameraUp = glm::normalize(glm::vec3(viewProj[0][1], viewProj[1][1], viewProj[2][1]));
+	updateTrackChunks(modelviewMat);
+
 	//######################################################################
 	// TODO: 
 	// you might want to set the lighting up differently. if you do, 
@@ -347,13 +604,47 @@ void TrainView::draw()
 		headlightModel->setColor(16, 16, 16);
 	}
 
+	// set to opengl fixed pipeline(use opengl 1.x draw function)
+	glUseProgram(0);
+
+	// the shader path is optional, without shaders or framebuffer objects
+	// we stay on the stencil shadows
+	bool shadowMapped = false;
+	if (tw->shadowMapButton->value()) {
+		if (!shadowMap->isCreated())
+			shadowMap->init("shaders/shadow.vert", "shaders/shadow.frag");
+		shadowMapped = shadowMap->isUsable();
+	}
+	if (shadowMapped)
+		drawShadowMapped(modelviewMat);
+	else
+		drawStencilShadowed();
+
+	if (regionSelecting)
+		drawSelectRegion();
+
+	if (frameTiming) {
+		glFinish();
+		std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+		recordFrameTime(frameTime.count(), shadowMapped);
+	}
+
+	frameCheck.verify(steadyFrame && listRevision() == checkedTrackRevision);
+	checkedTrackRevision = listRevision();
+}
+
+//************************************************************************
+//
+// * Floor and scene with the original planar shadows: the scene is drawn
+//   again squashed onto the floor, limited to the floor by the stencil
+//========================================================================
+void TrainView::drawStencilShadowed()
+{
 	//*********************************************************************
 	// now draw the ground plane
 	//*********************************************************************
-	// set to opengl fixed pipeline(use opengl 1.x draw function)
-	glUseProgram(0);
 	setupFloor();
-	drawFloor(200,100);
+	drawCachedFloor();
 
 	//*********************************************************************
 	// now draw the object and we need to do it twice
@@ -409,6 +700,52 @@ void TrainView::draw()
 	}
 }
 
+//************************************************************************
+//
+// * Floor and scene with shadow mapping. The depth map from the sun is
+//   only redrawn when the sun or something casting a shadow has changed
+//========================================================================
+void TrainView::drawShadowMapped(const glm::mat4& cameraModelview)
+{
+	bool sunShadows = tw->SunDegree2->value() < 90.0f;
+	// the train camera hides the control points, so their shadows go too
+	unsigned long shadowRevision = sceneRevision * 2 + (tw->trainCam->value() ? 1 : 0);
+	if (sunShadows && shadowMap->needsUpdate(sunlightPos, shadowRevision)) {
+		shadowMap->beginDepthPass(sunlightPos, shadowRevision);
+		drawStuff(true);
+		shadowMap->endDepthPass();
+	}
+
+	glDisable(GL_STENCIL_TEST);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_LIGHTING);
+	shadowMap->beginLitPass(cameraModelview, sunShadows);
+	drawCachedFloor();
+	drawStuff(false);
+	shadowMap->endLitPass();
+}
+
+//************************************************************************
+//
+// * Average the frame times of one shadow path, starting over when the
+//   path is switched
+//========================================================================
+void TrainView::recordFrameTime(double milliseconds, bool shadowMapped)
+{
+	if (shadowMapped != frameTimeShadowMapped) {
+		frameTimeShadowMapped = shadowMapped;
+		frameTimeSum = 0.0;
+		frameTimeNum = 0;
+	}
+	frameTimeSum += milliseconds;
+	frameTimeNum++;
+	if (frameTimeNum == 60) {
+		printf("%s shadows: %.2f ms/frame\n", shadowMapped ? "shadow map" : "stencil", frameTimeSum / frameTimeNum);
+		frameTimeSum = 0.0;
+		frameTimeNum = 0;
+	}
+}
+
 //************************************************************************
 //
 // * This sets up both the Projection and the ModelView matrices
@@ -491,19 +828,36 @@ setProjection()
 //========================================================================
 void TrainView::drawStuff(bool doingShadows)
 {
+	drawStaticStuff(doingShadows);
+	drawMovingStuff(doingShadows);
+}
+
+//************************************************************************
+//
+// * The parts of the world that only change when the track is rebuilt:
+//   control points, track, sleepers and trees
+//========================================================================
+void TrainView::drawStaticStuff(bool doingShadows)
+{
+	int pass = doingShadows ? 1 : 0;
+
 	// Draw the control points
 	// don't draw the control points if you're driving 
 	// (otherwise you get sea-sick as you drive through them)
 	//std::cout << (int)tw->headlightButton->value() << std::endl;
 	if (!tw->trainCam->value()) {
-		for (size_t i = 0; i < m_pTrack->points.size(); ++i) {
-			if (!doingShadows) {
-				if (((int)i) != selectedCube)
-					glColor3ub(240, 60, 60);
-				else
-					glColor3ub(240, 240, 30);
+		// the selection only changes colors, which shadows don't have
+		if (controlPointLists[pass].begin(m_pTrack->revision, doingShadows ? -1 : (int)selectionRevision)) {
+			for (size_t i = 0; i < m_pTrack->points.size(); ++i) {
+				if (!doingShadows) {
+					if (!isSelected((unsigned int)i))
+						glColor3ub(240, 60, 60);
+					else
+						glColor3ub(240, 240, 30);
+				}
+				m_pTrack->points[i].draw();
 			}
-			m_pTrack->points[i].draw();
+			controlPointLists[pass].end();
 		}
 	}
 	// draw the track
@@ -511,12 +865,26 @@ void TrainView::drawStuff(bool doingShadows)
 	// TODO: 
 	// call your own track drawing code
 	//####################################################################
+	if (trackLists[pass].begin(listRevision(), tw->ShowAdpsubButton->value())) {
 #ifdef EXAMPLE_SOLUTION
-	drawTrack(this, doingShadows);
+		drawTrack(this, doingShadows);
 #endif
-	drawTrack(doingShadows);
+		drawTrack(doingShadows);
 
+		if (treeAModel != NULL) {
+			treeAModel->draw(doingShadows);
+		}
+		trackLists[pass].end();
+	}
+}
 
+//************************************************************************
+//
+// * The parts of the world that move every frame: the train, its cars
+//   and the smoke
+//========================================================================
+void TrainView::drawMovingStuff(bool doingShadows)
+{
 	// draw the train
 	//####################################################################
 	// TODO: 
@@ -533,58 +901,53 @@ void TrainView::drawStuff(bool doingShadows)
 	}
 	if (headlightModel != NULL) {
 		if ((tw->trainCam->value() == 0) || doingShadows) {
-			if(tw->headlightButton->value()) glDisable(GL_LIGHTING);
-			else glEnable(GL_LIGHTING);
+			shadowMap->setLighting(!tw->headlightButton->value());
 			headlightModel->draw(doingShadows);
-			glEnable(GL_LIGHTING);
+			shadowMap->setLighting(true);
 		}
 	}
 	if (carModel != NULL)
 		carModel->draw(doingShadows);
 
-	smokeAnimation->Draw(doingShadows);
+	smokeParticles->draw(cameraRight, cameraUp, doingShadows);
+}
 
-	if (treeAModel != NULL) {
-		treeAModel->draw(doingShadows);
+//************************************************************************
+//
+// * The floor never changes, record it once instead of sending its
+//   10000 quads every frame
+//========================================================================
+void TrainView::drawCachedFloor()
+{
+	if (floorList.begin(0)) {
+		drawFloor(200, 100);
+		floorList.end();
 	}
 }
 void TrainView::drawTrack(bool doingShadows) {
-	//if (trackModel != NULL)
-	//	trackModel->draw(doingShadows, GL_QUADS);
-	if (trackModel != NULL) {
-		for (unsigned int meshIdx = 0; meshIdx < trackModel->meshes.size(); meshIdx++) {
-			Mesh& currMesh = trackModel->meshes[meshIdx];
+	if (trackModel != NULL && (doingShadows || !tw->ShowAdpsubButton->value()))
+		trackModel->draw(doingShadows, GL_QUADS);
+	else if (trackModel != NULL) {
+		// stripe every 4 quads so the adaptive subdivision segments show up
+		const MeshData& trackMesh = *trackModel->mesh;
+		for (unsigned int meshIdx = 0; meshIdx < trackMesh.meshes.size(); meshIdx++) {
+			const Mesh& currMesh = trackMesh.meshes[meshIdx];
 
 			glMatrixMode(GL_MODELVIEW);
 			glPushMatrix();
 			glMultMatrixf(glm::value_ptr(trackModel->transforms[0]));
-			//glLoadIdentity();
 
 			glBegin(GL_QUADS);
-			for (unsigned int i = 0; i < currMesh.posIndices.size(); i++) {
-				unsigned int index;
-
-				index = currMesh.normalIndices[i];
-				glm::vec3 drawNormal = trackModel->normals[index];
-				drawNormal = glm::normalize(drawNormal);
-				//glm::vec3 drawNormal = ModelClass::normals[index];
-				//std::cout << std::setprecision(2) << drawNormal.x << "\t" << drawNormal.y << "\t" << drawNormal.z << "\n";
-
-				index = currMesh.posIndices[i];
-				glm::vec3 drawPos = trackModel->verticesPos[index];
-				//glm::vec3 drawPos = ModelClass::transforms[idx] * glm::vec4(ModelClass::verticesPos[index], 1.0f);
-				if (!doingShadows) {
-					glm::vec3 color = currMesh.color;
-					if (tw->ShowAdpsubButton->value()) {
-						if ((i % 32) < 16)
-							color = color * 1.3f;
-						else
-							color = color * 0.7f;
-					}
-					glColor3ub(color.x, color.y, color.z);
-				}
-				glNormal3f(drawNormal.x, drawNormal.y, drawNormal.z);
-				glVertex3f(drawPos.x, drawPos.y, drawPos.z);
+			for (unsigned int i = 0; i < currMesh.indexNum; i++) {
+				const MeshVertex& vertex = trackMesh.vertices[trackMesh.indices[currMesh.firstIndex + i]];
+				glm::vec3 color = trackModel->colors[meshIdx];
+				if ((i % 32) < 16)
+					color = color * 1.3f;
+				else
+					color = color * 0.7f;
+				glColor3ub(color.x, color.y, color.z);
+				glNormal3f(vertex.normal.x, vertex.normal.y, vertex.normal.z);
+				glVertex3f(vertex.position.x, vertex.position.y, vertex.position.z);
 			}
 			glEnd();
 			glPopMatrix();
@@ -593,441 +956,154 @@ void TrainView::drawTrack(bool doingShadows) {
 
 	if (sleeperModel != NULL)
 		sleeperModel->draw(doingShadows);
+	// one merged mesh for all supports, a single draw
+	if (supportModel != NULL)
+		supportModel->draw(doingShadows, GL_QUADS);
+	// a streamed track has none of the above, its chunks near the train instead
+	if (trackChunks.active() && sleeperModel != NULL)
+		trackChunks.draw(*sleeperModel, doingShadows);
 }
 
 
-void TrainView::updateTrackSpline() {
-	//std::cout << "updateTrackSpline\n";
-	glm::mat4 splineMat;
-	unsigned int divide_line = 1;
-
-	// init spline matrix
-	if (tw->splineBrowser->selected(1)) {// linear
-		splineMat = glm::mat4(0, 0, 0, 0,
-			0, 0, 0, 0,
-			0, -1, 1, 0,
-			0, 1, 0, 0);
-		divide_line = 1;
-	}
-	else if (tw->splineBrowser->selected(2)) // Cardinal
-	{
-		//splineMat = glm::mat4(-1, 3, -3, 1,
-		//	2, -5, 4, -1,
-		//	-1, 0, 1, 0,
-		//	0, 2, 0, 0);
-		//splineMat = 0.5f * splineMat;
-		float T = tw->tensionSlider->value();
-		float s = (1.0f - T) / 2.0f;
-		splineMat = glm::mat4(-s, 2-s, s-2, s,
-			2*s, s-3, 3-2*s, -s,
-			-s, 0, s, 0,
-			0, 1, 0, 0);
-		divide_line = 100;
-	}
-	else if (tw->splineBrowser->selected(3)) // Cubic B-Spline
-	{
-		splineMat = glm::mat4(-1, 3, -3, 1,
-			3, -6, 3, 0,
-			-3, 0, 3, 0,
-			1, 4, 1, 0) / 6.0f;
-		divide_line = 100;
-	}
-	else {
-		splineMat = glm::mat4(0, 0, 0, 0,
-			0, 0, 0, 0,
-			0, -1, 1, 0,
-			0, 1, 0, 0);
-		divide_line = 1;
-	}
+int TrainView::splineType() {
+	if (tw->splineBrowser->selected(2)) return SPLINE_CARDINAL;
+	if (tw->splineBrowser->selected(3)) return SPLINE_BSPLINE;
+	return SPLINE_LINEAR;
+}
+void TrainView::treePositions(std::vector<glm::vec3>& positions) {
+	positions.assign(treesPositions, treesPositions + sizeof(treesPositions) / sizeof(glm::vec3));
+}
+void TrainView::getTrackBuildInput(TrackBuildInput& input) {
+	// init spline
+	TrackBuilder::setSpline(input, splineType(), (float)tw->tensionSlider->value());
+	if (divideLine > 0) input.divideLine = divideLine;
+	input.adaptive = tw->AdaptiveSubdivisionButton->value() != 0;
+	input.trackWidth = trackWidth;
+	input.sleeperSpacing = sleeperSpacing;
+	input.supportEvery = supportEvery;
+	input.streamSamples = trackStreamSamples;
 
 	unsigned int verticesNum = m_pTrack->points.size();
-	std::vector<glm::vec3> trackPos(verticesNum);
-	std::vector<glm::vec3> trackDirect(verticesNum);
-	std::vector<glm::vec3> trackOrient(verticesNum);
-	std::vector<glm::vec3> trackCross(verticesNum);
-	std::vector<glm::vec3> leftTrackPos(verticesNum);
-	std::vector<glm::vec3> rightTrackPos(verticesNum);
-
-	if (verticesNum < 4) return;
-
-	for (int i = 0; i < verticesNum; i++) {
-		trackPos[i] = glm::vec3(m_pTrack->points[i].pos.x,
+	input.positions.resize(verticesNum);
+	input.orients.resize(verticesNum);
+	for (unsigned int i = 0; i < verticesNum; i++) {
+		input.positions[i] = glm::vec3(m_pTrack->points[i].pos.x,
 			m_pTrack->points[i].pos.y,
 			m_pTrack->points[i].pos.z);
-	}
-
-	for (int i = 0; i < verticesNum; i++) {
-		trackDirect[i] = trackPos[(i + 1) % verticesNum] - trackPos[i];
-		trackOrient[i] = glm::vec3(m_pTrack->points[i].orient.x,
+		input.orients[i] = glm::vec3(m_pTrack->points[i].orient.x,
 			m_pTrack->points[i].orient.y,
 			m_pTrack->points[i].orient.z);
 	}
+	treePositions(input.treePositions);
+}
+void TrainView::updateTrackSpline() {
+	// anything still building is older than this
+	trackBuilder.cancel();
+	TrackBuildInput input;
+	getTrackBuildInput(input);
+	if (TrackBuilder::build(input, trackBuildResult))
+		applyTrackBuild(trackBuildResult);
+}
+void TrainView::requestTrackSpline(bool resetTrain) {
+	if (resetTrain) trackResetPending = true;
+	TrackBuildInput input;
+	getTrackBuildInput(input);
+	trackBuilder.request(input);
+}
+void TrainView::publishTrackSpline() {
+	if (!trackBuilder.takeResult(trackBuildResult)) return;
+	applyTrackBuild(trackBuildResult);
+	if (trackResetPending) trainReset();
+	trackResetPending = false;
+	trainMove(0.0f);
+	redrawScheduler.invalidate();
+}
+// swap the built track in, the old contents go back to the builder with
+// the result. the train samples go to the simulation thread as they are
+void TrainView::applyTrackBuild(TrackBuildResult& result) {
+	track = result.track;
+	result.track.reset();
+	simulation.setTrack(track);
+	treesOnTrack.swap(result.treeOnTrack);
 
-	for (int i = 0; i < verticesNum; i++) {
-		glm::vec3 cr0 = glm::cross(trackDirect[i], trackOrient[i]);
-		glm::vec3 cr1 = glm::cross(trackDirect[(i + 1) % verticesNum], trackOrient[(i + 1) % verticesNum]);
-		trackCross[(i + 1) % verticesNum] = glm::normalize(glm::normalize(cr0) + glm::normalize(cr1));
-	}
-
-	for (int i = 0; i < verticesNum; i++) {
-		leftTrackPos[i] = trackPos[i] - 0.5f * trackWidth * trackCross[i];
-	}
-
-	for (int i = 0; i < verticesNum; i++) {
-		rightTrackPos[i] = trackPos[i] + 0.5f * trackWidth * trackCross[i];
-	}
-
-	// calculate spline 
-	std::vector<glm::vec3> leftTrackSplinePosOri = spline(splineMat, leftTrackPos, divide_line);
-	std::vector<glm::vec3> rightTrackSplinePosOri = spline(splineMat, rightTrackPos, divide_line);
-
-	std::vector<glm::vec3> trackSplinePosOri = spline(splineMat, trackPos, divide_line);
-	std::vector<glm::vec3> trackSplineCrossOri = spline(splineMat, trackCross, divide_line);
-
-	// Adaptive subdivision
-	trackSplinePos.clear();
-	leftTrackSplinePos.clear();
-	rightTrackSplinePos.clear();
-	trackSplineCross.clear();
-	if (tw->AdaptiveSubdivisionButton->value()) {
-		trackSplinePos.push_back(trackSplinePosOri[0]);
-		leftTrackSplinePos.push_back(leftTrackSplinePosOri[0]);
-		rightTrackSplinePos.push_back(rightTrackSplinePosOri[0]);
-		trackSplineCross.push_back(trackSplineCrossOri[0]);
-		for (unsigned int i = 1; i < trackSplinePosOri.size(); i++) {
-			glm::vec3 prePos = trackSplinePos.back();
-			glm::vec3 newPos = trackSplinePosOri[i];
-
-			float trueLen = glm::length(newPos - prePos);
-			float newLen = glm::length(trackSplinePos.back() - newPos);
-			while ((trueLen - newLen) < 0.001f) {
-				i = i + 1;
-				if (i >= trackSplinePosOri.size()) break;
-				prePos = newPos;
-				newPos = trackSplinePosOri[i];
-				trueLen = trueLen + glm::length(newPos - prePos);
-
-				newLen = glm::length(trackSplinePos.back() - newPos);
-			}
-			i = i - 1;
-			trackSplinePos.push_back(trackSplinePosOri[i]);
-			leftTrackSplinePos.push_back(leftTrackSplinePosOri[i]);
-			rightTrackSplinePos.push_back(rightTrackSplinePosOri[i]);
-			trackSplineCross.push_back(trackSplineCrossOri[i]);
-		}
-	}
-	else {
-		trackSplinePos = trackSplinePosOri;
-		leftTrackSplinePos = leftTrackSplinePosOri;
-		rightTrackSplinePos = rightTrackSplinePosOri;
-		trackSplineCross = trackSplineCrossOri;
-	}
-
-	//
-	trackLength = 0;
-	trackSplineDirect.resize(trackSplinePos.size());
-	trackSplineLength.resize(trackSplinePos.size());
-	for (int i = 0; i < trackSplinePos.size(); i++) {
-		trackSplineDirect[i] = trackSplinePos[(i + 1) % trackSplinePos.size()] - trackSplinePos[i];
-		trackLength += glm::length(trackSplineDirect[i]);
-		trackSplineLength[i] = trackLength;
-	}
 	// update track model
-	buildTrackModel(leftTrackSplinePos, rightTrackSplinePos, trackSplineCross, trackSplineDirect);
+	trackModel->setMesh(result.trackMesh);
 	trackModel->setColor(128, 128, 128);
+	result.trackMesh.reset();
 
 	// sleepers
-	unsigned int sleeperNum = trackLength / 10.0f;
-	float stepLength = trackLength / (float)sleeperNum;
-	float currLength = 0.0f;
-	unsigned int currArcIdx = 0;
-	sleeperModel->transforms.resize(sleeperNum);
-	for (int i = 0; i < sleeperNum; i++) {
-		float targetLength = i * stepLength;
-		float arcLength = 0.0f;
-		while (1) {
-			currLength += arcLength;
-			arcLength = glm::length(trackSplineDirect[currArcIdx]);
-			if ((currLength + arcLength) >= targetLength) break;
-			currArcIdx = (currArcIdx + 1) % trackSplineDirect.size();
-		}
-		float t = (targetLength - currLength) / arcLength;
-		glm::vec3 sleeperPos = (1 - t) * trackSplinePos[currArcIdx] + t * trackSplinePos[(currArcIdx + 1) % trackSplinePos.size()];
-		//glm::vec3 sleeperCross = trackSplineCross[currArcIdx];
-		glm::vec3 sleeperCross = (1 - t)* trackSplineCross[currArcIdx] + t * trackSplineCross[(currArcIdx + 1) % trackSplineCross.size()];
-		glm::vec3 sleeperDirect = trackSplineDirect[currArcIdx];
-
-
-		glm::mat4 transform = glm::mat4(1.0f);
-		transform = glm::scale(glm::vec3(0.15f, 0.15f, 0.15f)) * transform;
-		glm::vec3 new_z = glm::normalize(sleeperDirect);
-		glm::vec3 new_y = glm::normalize(-glm::cross(sleeperDirect, sleeperCross));
-		glm::vec3 new_x = glm::normalize(glm::cross(new_z, new_y));
-		glm::mat3 rotate = glm::mat3(new_x, new_y, new_z);
-		transform = glm::mat4(
-			new_x.x, new_x.y, new_x.z, 0.0f,
-			new_y.x, new_y.y, new_y.z, 0.0f,
-			new_z.x, new_z.y, new_z.z, 0.0f,
-			0.0f, 0.0f, 0.0f, 1.0f
-		) * transform;
-		transform = glm::translate(sleeperPos) * transform;
-		sleeperModel->transforms[i] = transform;
-	}
+	sleeperModel->transforms.swap(result.sleeperTransforms);
+
+	// supports
+	supportModel->setMesh(result.supportMesh);
+	supportModel->setColor(96, 88, 80);
+	result.supportMesh.reset();
+
+	trackChunks.setTrack(result.streamed ? track : std::shared_ptr<const TrackData>(), sleeperSpacing, supportEvery);
 
-	TrainView::trainControl->UpdateTruckParameter(&trackSplinePos, &trackSplineDirect, &trackSplineCross, &trackSplineLength);
-	for(unsigned int carControlIdx=0; carControlIdx< TrainView::carControl.size(); carControlIdx++)
-		TrainView::carControl[carControlIdx]->UpdateTruckParameter(&trackSplinePos, &trackSplineDirect, &trackSplineCross, &trackSplineLength);
 	initTrees();
+	sceneRevision++;
+	trackRevision++;
 }
-void TrainView::buildTrackModel(std::vector<glm::vec3>& positions1, std::vector<glm::vec3>& positions2,
-	std::vector<glm::vec3>& crosses, std::vector<glm::vec3>& directs) {
-	std::vector<glm::vec3> verticesPosition;
-	std::vector<glm::vec3> verticesNormal;
-	std::vector<glm::vec3>& positions = positions1;
-	for (unsigned int i = 0; i < positions.size(); i++) {
-		glm::vec3 begUp = glm::normalize(glm::cross(directs[i], crosses[i]));
-		glm::vec3 endUp = glm::normalize(glm::cross(directs[(i + 1) % directs.size()], crosses[(i + 1) % crosses.size()]));
-		glm::vec3 begPos = positions[i];
-		glm::vec3 endPos = positions[(i + 1) % positions.size()];
-		glm::vec3 begCross = crosses[i];
-		glm::vec3 endCross = crosses[(i + 1) % crosses.size()];
-
-		//top
-		verticesPosition.push_back(begPos + begCross * 0.375f + begUp * 0.375f);
-		verticesPosition.push_back(begPos - begCross * 0.375f + begUp * 0.375f);
-		verticesPosition.push_back(endPos - endCross * 0.375f + endUp * 0.375f);
-		verticesPosition.push_back(endPos + endCross * 0.375f + endUp * 0.375f);
-		verticesNormal.push_back(glm::normalize(begUp));
-		verticesNormal.push_back(glm::normalize(begUp));
-		verticesNormal.push_back(glm::normalize(endUp));
-		verticesNormal.push_back(glm::normalize(endUp));
-		//bottom
-		verticesPosition.push_back(begPos + begCross * 0.375f - begUp * 0.375f);
-		verticesPosition.push_back(begPos - begCross * 0.375f - begUp * 0.375f);
-		verticesPosition.push_back(endPos - endCross * 0.375f - endUp * 0.375f);
-		verticesPosition.push_back(endPos + endCross * 0.375f - endUp * 0.375f);
-		verticesNormal.push_back(glm::normalize(-begUp));
-		verticesNormal.push_back(glm::normalize(-begUp));
-		verticesNormal.push_back(glm::normalize(-endUp));
-		verticesNormal.push_back(glm::normalize(-endUp));
-		//left
-		verticesPosition.push_back(begPos + begCross * 0.375f + begUp * 0.375f);
-		verticesPosition.push_back(begPos + begCross * 0.375f - begUp * 0.375f);
-		verticesPosition.push_back(endPos + endCross * 0.375f - endUp * 0.375f);
-		verticesPosition.push_back(endPos + endCross * 0.375f + endUp * 0.375f);
-		verticesNormal.push_back(glm::normalize(begCross));
-		verticesNormal.push_back(glm::normalize(begCross));
-		verticesNormal.push_back(glm::normalize(endCross));
-		verticesNormal.push_back(glm::normalize(endCross));
-		//right
-		verticesPosition.push_back(begPos - begCross * 0.375f + begUp * 0.375f);
-		verticesPosition.push_back(begPos - begCross * 0.375f - begUp * 0.375f);
-		verticesPosition.push_back(endPos - endCross * 0.375f - endUp * 0.375f);
-		verticesPosition.push_back(endPos - endCross * 0.375f + endUp * 0.375f);
-		verticesNormal.push_back(glm::normalize(-begCross));
-		verticesNormal.push_back(glm::normalize(-begCross));
-		verticesNormal.push_back(glm::normalize(-endCross));
-		verticesNormal.push_back(glm::normalize(-endCross));
-	}
-	positions = positions2;
-	for (unsigned int i = 0; i < positions.size(); i++) {
-		glm::vec3 begUp = glm::normalize(glm::cross(directs[i], crosses[i]));
-		glm::vec3 endUp = glm::normalize(glm::cross(directs[(i + 1) % directs.size()], crosses[(i + 1) % crosses.size()]));
-		glm::vec3 begPos = positions[i];
-		glm::vec3 endPos = positions[(i + 1) % positions.size()];
-		glm::vec3 begCross = crosses[i];
-		glm::vec3 endCross = crosses[(i + 1) % crosses.size()];
-
-		//top
-		verticesPosition.push_back(begPos + begCross * 0.375f + begUp * 0.375f);
-		verticesPosition.push_back(begPos - begCross * 0.375f + begUp * 0.375f);
-		verticesPosition.push_back(endPos - endCross * 0.375f + endUp * 0.375f);
-		verticesPosition.push_back(endPos + endCross * 0.375f + endUp * 0.375f);
-		verticesNormal.push_back(glm::normalize(begUp));
-		verticesNormal.push_back(glm::normalize(begUp));
-		verticesNormal.push_back(glm::normalize(endUp));
-		verticesNormal.push_back(glm::normalize(endUp));
-		//bottom
-		verticesPosition.push_back(begPos + begCross * 0.375f - begUp * 0.375f);
-		verticesPosition.push_back(begPos - begCross * 0.375f - begUp * 0.375f);
-		verticesPosition.push_back(endPos - endCross * 0.375f - endUp * 0.375f);
-		verticesPosition.push_back(endPos + endCross * 0.375f - endUp * 0.375f);
-		verticesNormal.push_back(glm::normalize(-begUp));
-		verticesNormal.push_back(glm::normalize(-begUp));
-		verticesNormal.push_back(glm::normalize(-endUp));
-		verticesNormal.push_back(glm::normalize(-endUp));
-		//left
-		verticesPosition.push_back(begPos + begCross * 0.375f + begUp * 0.375f);
-		verticesPosition.push_back(begPos + begCross * 0.375f - begUp * 0.375f);
-		verticesPosition.push_back(endPos + endCross * 0.375f - endUp * 0.375f);
-		verticesPosition.push_back(endPos + endCross * 0.375f + endUp * 0.375f);
-		verticesNormal.push_back(glm::normalize(begCross));
-		verticesNormal.push_back(glm::normalize(begCross));
-		verticesNormal.push_back(glm::normalize(endCross));
-		verticesNormal.push_back(glm::normalize(endCross));
-		//right
-		verticesPosition.push_back(begPos - begCross * 0.375f + begUp * 0.375f);
-		verticesPosition.push_back(begPos - begCross * 0.375f - begUp * 0.375f);
-		verticesPosition.push_back(endPos - endCross * 0.375f - endUp * 0.375f);
-		verticesPosition.push_back(endPos - endCross * 0.375f + endUp * 0.375f);
-		verticesNormal.push_back(glm::normalize(-begCross));
-		verticesNormal.push_back(glm::normalize(-begCross));
-		verticesNormal.push_back(glm::normalize(-endCross));
-		verticesNormal.push_back(glm::normalize(-endCross));
-	}
-	trackModel->loadVertices(verticesPosition, verticesNormal);
+bool TrainView::loadBundle(const char* fileName, TrackParseError& error) {
+	std::vector<ControlPoint> points;
+	TrackBakeSettings settings;
+	TrackBuildResult result;
+	if (!TrackBundle::load(fileName, trackStreamSamples, points, settings, result, error))
+		return false;
+
+	// later edits rebuild the track the way it was baked, until the spline
+	// type changes
+	tw->splineBrowser->select(settings.splineType + 1);
+	tw->tensionSlider->value(settings.tension);
+	tw->AdaptiveSubdivisionButton->value(settings.adaptive ? 1 : 0);
+	trackWidth = settings.trackWidth;
+	sleeperSpacing = settings.sleeperSpacing;
+	supportEvery = settings.supportEvery;
+	divideLine = settings.divideLine;
+
+	// anything still building is for the old points
+	trackBuilder.cancel();
+	std::vector<ControlPoint> oldPoints;
+	oldPoints.swap(m_pTrack->points);
+	m_pTrack->points.swap(points);
+	selectPoint(-1, false);
+	TrackEdit edit(this);
+	edit.replaced(oldPoints);
+	edit.commit(true, false);
+
+	applyTrackBuild(result);
+	trainReset();
+	trainMove(0.0f);
+	redrawScheduler.invalidate();
+	return true;
 }
-void TrainView::drawTrackSpline(glm::mat4& splineMat, unsigned int divide_line, bool doingShadows) {
-	unsigned int verticesNum = m_pTrack->points.size();
-	std::vector<glm::vec3> trackPos(verticesNum);
-	std::vector<glm::vec3> trackDirect(verticesNum);
-	std::vector<glm::vec3> trackOrient(verticesNum);
-	std::vector<glm::vec3> trackCross(verticesNum);
-	std::vector<glm::vec3> leftTrackPos(verticesNum);
-	std::vector<glm::vec3> rightTrackPos(verticesNum);
-
-	if (verticesNum < 4) return;
-
-	for (int i = 0; i < verticesNum; i++) {
-		trackPos[i] = glm::vec3(m_pTrack->points[i].pos.x,
-			m_pTrack->points[i].pos.y,
-			m_pTrack->points[i].pos.z);
-	}
-
-	for (int i = 0; i < verticesNum; i++) {
-		trackDirect[i] = trackPos[(i + 1) % verticesNum] - trackPos[i];
-		trackOrient[i] = glm::vec3(m_pTrack->points[i].orient.x,
-			m_pTrack->points[i].orient.y,
-			m_pTrack->points[i].orient.z);
-	}
-
-	for (int i = 0; i < verticesNum; i++) {
-		glm::vec3 cr0 = glm::cross(trackDirect[i], trackOrient[i]);
-		glm::vec3 cr1 = glm::cross(trackDirect[(i + 1) % verticesNum], trackOrient[(i + 1) % verticesNum]);
-		trackCross[(i + 1) % verticesNum] = glm::normalize(glm::normalize(cr0) + glm::normalize(cr1));
-	}
-
-	for (int i = 0; i < verticesNum; i++) {
-		leftTrackPos[i] = trackPos[i] - 0.5f * trackWidth * trackCross[i];
-	}
-
-	for (int i = 0; i < verticesNum; i++) {
-		rightTrackPos[i] = trackPos[i] + 0.5f * trackWidth * trackCross[i];
-	}
-
-	std::vector<glm::vec3> leftTrackSplinePos = spline(splineMat, leftTrackPos, divide_line);
-	std::vector<glm::vec3> rightTrackSplinePos = spline(splineMat, rightTrackPos, divide_line);
-
-	drawlinesloop(leftTrackSplinePos, doingShadows);
-	drawlinesloop(rightTrackSplinePos, doingShadows);
-
-	std::vector<glm::vec3> trackSplinePos = spline(splineMat, trackPos, divide_line);
-	std::vector<glm::vec3> trackSplineCross = spline(splineMat, trackCross, divide_line);
-
-
-	// sleeper
-	float trackLength = 0;
-	std::vector<glm::vec3> trackSplineDirect(trackSplinePos.size());
-	for (int i = 0; i < trackSplinePos.size(); i++) {
-		trackSplineDirect[i] = trackSplinePos[(i + 1) % trackSplinePos.size()] - trackSplinePos[i];
-		trackLength += glm::length(trackSplineDirect[i]);
-	}
-	unsigned int sleeperNum = trackLength / 10.0f;
-	//std::cout << sleeperNum << " , " << trackLength << std::endl;
-	float stepLength = trackLength / (float)sleeperNum;
-	float currLength = 0.0f;
-	unsigned int currArcIdx = 0;
-	sleeperModel->transforms.resize(sleeperNum);
-	for (int i = 0; i < sleeperNum; i++) {
-		float targetLength = i * stepLength;
-		float arcLength = 0.0f;
-		while(1) {
-			currLength += arcLength;
-			arcLength = glm::length(trackSplineDirect[currArcIdx]);
-			if ((currLength + arcLength) >= targetLength) break;
-			currArcIdx = (currArcIdx + 1)% trackSplineDirect.size();
-		}
-		float t = (targetLength - currLength) / arcLength;
-		glm::vec3 sleeperPos = (1 - t) * trackSplinePos[currArcIdx] + t * trackSplinePos[(currArcIdx + 1) % trackSplinePos.size()];
-		glm::vec3 sleeperLeftPos = (1 - t) * leftTrackSplinePos[currArcIdx] + t * leftTrackSplinePos[(currArcIdx + 1) % leftTrackSplinePos.size()];
-		glm::vec3 sleeperRightPos = (1 - t) * rightTrackSplinePos[currArcIdx] + t * rightTrackSplinePos[(currArcIdx + 1) % rightTrackSplinePos.size()];
-		//glm::vec3 sleeperCross = (1 - t) * trackSplineCross[currArcIdx] + t * trackSplineCross[(currArcIdx + 1) % trackSplineCross.size()];
-		//glm::vec3 sleeperDirect = (1 - t) * trackSplineDirect[currArcIdx] + t * trackSplineDirect[(currArcIdx + 1) % trackSplineDirect.size()];
-		glm::vec3 sleeperCross = trackSplineCross[currArcIdx];
-		glm::vec3 sleeperDirect = trackSplineDirect[currArcIdx];
-
-		//sleeperModel->transforms[i] = glm::translate(sleeperPos) *
-		//	glm::orientation(glm::normalize(sleeperCross), glm::vec3(1.0f, 0.0f, 0.0f)) *
-		//	glm::scale(glm::vec3(0.15f, 0.15f, 0.15f)) *
-		//	glm::mat4(1.0f);
-		glm::mat4 transform = glm::mat4(1.0f);
-		transform = glm::scale(glm::vec3(0.15f, 0.15f, 0.15f)) * transform;
-		glm::vec3 new_z = glm::normalize(sleeperDirect);
-		glm::vec3 new_y = glm::normalize(-glm::cross(sleeperDirect, sleeperCross));
-		glm::vec3 new_x = glm::normalize(glm::cross(new_z, new_y));
-		glm::mat3 rotate= glm::mat3(new_x, new_y, new_z);
-		transform = glm::mat4(
-			new_x.x, new_x.y, new_x.z, 0.0f,
-			new_y.x, new_y.y, new_y.z, 0.0f,
-			new_z.x, new_z.y, new_z.z, 0.0f,
-			0.0f, 0.0f, 0.0f, 1.0f
-			) * transform;
-		transform = glm::translate(sleeperPos) * transform;
-		sleeperModel->transforms[i] = transform;
-		//sleeperModel->transforms[i] = glm::translate(sleeperPos) *
-		//	glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::normalize(sleeperDirect * glm::vec3(-1.0f, -1.0f, 1.0f)), glm::normalize(glm::cross(sleeperCross, sleeperDirect))) *
-		//	glm::scale(glm::vec3(0.15f, 0.15f, 0.15f)) *
-		//	glm::mat4(1.0f);
-	
-		//glLineWidth(3);
-		//glBegin(GL_POLYGON);
-		////glBegin(GL_LINE);
-		//if (!doingShadows)
-		//	glColor3ub(255, 255, 255);
-
-		//const float sleeperWidthPad = 5.0f;
-		//const float sleeperLength = 8.0f;
-
-		//glm::vec3 drawPos;
-		//drawPos = sleeperRightPos + 0.5f * sleeperWidthPad * sleeperCross + 0.5f * sleeperLength * glm::normalize(sleeperDirect);
-		//glVertex3f(drawPos.x, drawPos.y, drawPos.z);
-		//drawPos = sleeperLeftPos - 0.5f * sleeperWidthPad * sleeperCross + 0.5f * sleeperLength * glm::normalize(sleeperDirect);
-		//glVertex3f(drawPos.x, drawPos.y, drawPos.z);
-		//drawPos = sleeperLeftPos - 0.5f * sleeperWidthPad * sleeperCross - 0.5f * sleeperLength * glm::normalize(sleeperDirect);
-		//glVertex3f(drawPos.x, drawPos.y, drawPos.z);
-		//drawPos = sleeperRightPos + 0.5f * sleeperWidthPad * sleeperCross - 0.5f * sleeperLength * glm::normalize(sleeperDirect);
-		//glVertex3f(drawPos.x, drawPos.y, drawPos.z);
-
-		//glEnd();
-		//glLineWidth(1);
-	}
-	sleeperModel->draw(doingShadows);
-
+void TrainView::resetBakeSettings() {
+	TrackBakeSettings settings;
+	trackWidth = settings.trackWidth;
+	sleeperSpacing = settings.sleeperSpacing;
+	supportEvery = settings.supportEvery;
+	divideLine = settings.divideLine;
 }
-std::vector<glm::vec3> TrainView::spline(glm::mat4& splineMat, std::vector<glm::vec3>& vertices, unsigned int divide_line) {
-	std::vector<glm::vec3> splinePos(vertices.size() * divide_line);
-	unsigned int splinePosIdx = 0;
-	for (int i = 0; i < vertices.size(); i++) {
-		glm::vec3* controlPositions[4];
-		for (int j = 0; j < 4; j++) {
-			controlPositions[j] = &(vertices[(i + j) % vertices.size()]);
-		}
-		float percent = 1.0f / divide_line;
-		float t = 0;
-
-		glm::mat4 controlPosMat(controlPositions[0]->x, controlPositions[0]->y, controlPositions[0]->z, 1.0f,
-			controlPositions[1]->x, controlPositions[1]->y, controlPositions[1]->z, 1.0f,
-			controlPositions[2]->x, controlPositions[2]->y, controlPositions[2]->z, 1.0f,
-			controlPositions[3]->x, controlPositions[3]->y, controlPositions[3]->z, 1.0f);
-
-		for (int j = 0; j < divide_line; j++) {
-			splinePos[splinePosIdx++] = controlPosMat * splineMat * glm::vec4(powf(t, 3), powf(t, 2), t, 1.0f);
-			t += percent;
-		}
+unsigned long TrainView::listRevision() {
+	return trackRevision + chunkRevision;
+}
+// the chunks change as the train and the camera move, the track display
+// lists are recorded again when they do. the track itself is the same, so
+// the picker keeps its layers
+void TrainView::updateTrackChunks(const glm::mat4& modelviewMat) {
+	if (!trackChunks.active()) return;
+	glm::vec3 focus[2];
+	focus[0] = trainModel->positions[0];
+	focus[1] = glm::vec3(glm::inverse(modelviewMat)[3]);
+	if (trackChunks.update(focus, 2)) {
+		sceneRevision++;
+		chunkRevision++;
 	}
-	return splinePos;
+	// the rest of the chunks in the next frames
+	if (trackChunks.pending())
+		redrawScheduler.invalidate();
 }
-
 //unused
 void TrainView::drawSpline(glm::mat4& splineMat, std::vector<glm::vec3>& vertices, bool doingShadows) {
 	const int DIVIDE_LINE = 10;
@@ -1098,53 +1174,31 @@ void TrainView::drawlinesloopBox(std::vector<glm::vec3>& positions, std::vector<
 
 
 void TrainView::trainMove(float distance) {
-	int mode = (tw->splineBrowser->selected(1) == 0) && (tw->tensionSlider->value() < 0.99f);
-	TrainView::trainControl->Move(distance, 0, mode);
-	for (unsigned int carControlIdx = 0; carControlIdx < TrainView::carControl.size(); carControlIdx++) {
-		//std::cout << "move Cars " << carControlIdx << "-" << carModel->transforms.size() << std::endl;
-		TrainView::carControl[carControlIdx]->Move(distance, carControlIdx, mode);
-	}
-	headlightModel->transforms[0] = trainModel->transforms[0];
-	//std::cout << "move Done" << std::endl;
+	tw->pushSimControls();
+	simulation.move(distance);
 }
 void TrainView::trainReset() {
-	TrainView::trainControl->ResetProcess();
-	for (unsigned int carControlIdx = 0; carControlIdx < TrainView::carControl.size(); carControlIdx++) {
-		TrainView::carControl[carControlIdx]->ResetProcess();
-		TrainView::carControl[carControlIdx]->SetProcess(0.0f);
-		TrainView::carControl[carControlIdx]->Move(trainControl->GetProcess() - 11 * carControlIdx - 13);
-	}
+	simulation.reset();
 }
 void TrainView::setCars(unsigned int num) {
-	//std::cout << "setCars " << carControl.size() << "-" << num << std::endl;
-	carModel->setInstanceNum(num);
-	if (carControl.size() < num) {
-		while (carControl.size() < num) {
-			CaronTrack* newControl = new CaronTrack(carModel);
-			newControl->UpdateTruckParameter(&trackSplinePos, &trackSplineDirect, &trackSplineCross, &trackSplineLength);
-			newControl->Move(trainControl->GetProcess() - 11 * carControl.size()-13);
-			carControl.push_back(newControl);
-		}
-	}
-	if (carControl.size() > num) {
-		while (carControl.size() > num) {
-			CaronTrack* delControl = carControl.back();
-			carControl.pop_back();
-			delete delControl;
-		}
-	}
+	simulation.setCars(num);
+}
+void TrainView::applySnapshot(SceneSnapshot& snapshot) {
+	snapshot.train.copyTo(*trainModel);
+	snapshot.cars.copyTo(*carModel);
+	headlightModel->transforms[0] = trainModel->transforms[0];
+	*smokeParticles = snapshot.smoke;
+	sceneRevision++;
 }
 // 
 //************************************************************************
 //
 // * this tries to see which control point is under the mouse
 //	  (for when the mouse is clicked)
-//		it uses OpenGL picking - which is always a trick
-//########################################################################
-// TODO: 
-//		if you want to pick things other than control points, or you
-//		changed how control points are drawn, you might need to change this
-//########################################################################
+//		it casts the mouse ray on the CPU against boxes around the
+//		control points, the track, the train, the cars and the trees,
+//		and takes the nearest hit. if you change how something is drawn,
+//		change its box in updatePicker() too
 //========================================================================
 void TrainView::
 doPick()
@@ -1154,95 +1208,319 @@ doPick()
 	// active window
 	make_current();		
 
-	// where is the mouse?
-	int mx = Fl::event_x(); 
-	int my = Fl::event_y();
+	// the mouse ray through the camera the last frame was drawn with
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	setProjection();
+	double r1x, r1y, r1z, r2x, r2y, r2z;
+	getMouseLine(r1x, r1y, r1z, r2x, r2y, r2z);
+	glm::vec3 rayOrigin((float)r1x, (float)r1y, (float)r1z);
+	glm::vec3 rayDirection((float)(r2x - r1x), (float)(r2y - r1y), (float)(r2z - r1z));
+
+	// the nearest thing under the mouse, cast on the CPU
+	updatePicker();
+	selectedCube = -1;
+	if (!picker.cast(rayOrigin, rayDirection, lastPick)) {
+		lastPick.kind = -1;
+		printf("Selected Cube %d\n",selectedCube);
+		return;
+	}
+	static const char* kindNames[Picker::KIND_NUM] = { "control point", "track sample", "train", "car", "tree" };
+	if (lastPick.kind == Picker::CONTROL_POINT) {
+		selectedCube = (int)lastPick.index;
+		printf("Selected Cube %d\n",selectedCube);
+	}
+	else
+		printf("Picked %s %u\n", kindNames[lastPick.kind], lastPick.index);
+}
+
+//************************************************************************
+//
+// * Each kind of pickable thing is refilled only when the revision
+//   counter that goes with it has moved
+//========================================================================
+void TrainView::updatePicker()
+{
+	if (picker.begin(Picker::CONTROL_POINT, m_pTrack->revision)) {
+		// the cube ControlPoint::draw() draws, and a box inside the point on top
+		for (size_t i = 0; i < m_pTrack->points.size(); ++i) {
+			const ControlPoint& point = m_pTrack->points[i];
+			float theta1 = -atan2f(point.orient.z, point.orient.x);
+			float theta2 = -acosf(fmaxf(-1.0f, fminf(1.0f, point.orient.y)));
+			glm::mat4 transform = glm::translate(glm::vec3(point.pos.x, point.pos.y, point.pos.z)) *
+				glm::rotate(theta1, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::rotate(theta2, glm::vec3(0.0f, 0.0f, 1.0f));
+			picker.add(Picker::CONTROL_POINT, (unsigned int)i, transform, glm::vec3(-2.0f), glm::vec3(2.0f));
+			picker.add(Picker::CONTROL_POINT, (unsigned int)i, transform, glm::vec3(-1.0f, 2.0f, -1.0f), glm::vec3(1.0f, 4.0f, 1.0f));
+		}
+	}
+
+	// a layer is only taken as up to date once its geometry is there, so
+	// a model that loads later is picked up even if nothing else changed
+	if (track && picker.begin(Picker::TRACK, trackRevision)) {
+		// a box around both rails along each segment
+		float halfWidth = 0.5f * trackWidth + 0.375f;
+		for (unsigned int i = 0; i < track->size(); i++) {
+			glm::vec3 direct = track->direct(i);
+			float length = glm::length(direct);
+			if (length <= 0.0f) continue;
+			glm::vec3 forward = direct / length;
+			glm::vec3 up = glm::normalize(-glm::cross(direct, track->cross(i)));
+			glm::vec3 side = glm::normalize(glm::cross(forward, up));
+			glm::mat4 transform(glm::vec4(side, 0.0f), glm::vec4(up, 0.0f), glm::vec4(forward, 0.0f),
+				glm::vec4(track->position(i) + 0.5f * direct, 1.0f));
+			picker.add(Picker::TRACK, i, transform,
+				glm::vec3(-halfWidth, -0.375f, -0.5f * length), glm::vec3(halfWidth, 0.375f, 0.5f * length));
+		}
+	}
+
+	if (treeAModel->mesh->indexNum > 0 && picker.begin(Picker::TREE, trackRevision)) {
+		for (unsigned int i = 0; i < treeAModel->transforms.size(); i++) {
+			// trees on the track are scaled away
+			if (i < treesOnTrack.size() && treesOnTrack[i]) continue;
+			picker.add(Picker::TREE, i, treeAModel->transforms[i], treeAModel->mesh->boundsMin, treeAModel->mesh->boundsMax);
+		}
+	}
+
+	// the train and the cars move with every snapshot
+	if (trainModel->mesh->indexNum > 0 && picker.begin(Picker::TRAIN, sceneRevision))
+		picker.add(Picker::TRAIN, 0, trainModel->transforms[0], trainModel->mesh->boundsMin, trainModel->mesh->boundsMax);
+	if (carModel->mesh->indexNum > 0 && picker.begin(Picker::CAR, sceneRevision)) {
+		for (unsigned int i = 0; i < carModel->transforms.size(); i++)
+			picker.add(Picker::CAR, i, carModel->transforms[i], carModel->mesh->boundsMin, carModel->mesh->boundsMax);
+	}
+}
+
+//************************************************************************
+//
+// * The selection is a sorted list of control point numbers. A click
+//   selects one point (shift toggles it), dragging on nothing selects
+//   the points inside a box or a lasso
+//========================================================================
+void TrainView::selectPoint(int index, bool add)
+{
+	if (!add) selectedPoints.clear();
+	selectedCube = index;
+	if (index >= 0) {
+		std::vector<unsigned int>::iterator place = std::lower_bound(selectedPoints.begin(), selectedPoints.end(), (unsigned int)index);
+		if (place != selectedPoints.end() && *place == (unsigned int)index) {
+			selectedPoints.erase(place);
+			selectedCube = -1;
+		}
+		else
+			selectedPoints.insert(place, (unsigned int)index);
+	}
+	selectionRevision++;
+}
+
+bool TrainView::isSelected(unsigned int index)
+{
+	return std::binary_search(selectedPoints.begin(), selectedPoints.end(), index);
+}
+
+// even-odd rule, so a lasso crossing itself still works
+static bool insideRegion(const std::vector<glm::vec2>& polygon, const glm::vec2& p)
+{
+	bool inside = false;
+	for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+		const glm::vec2& a = polygon[i];
+		const glm::vec2& b = polygon[j];
+		if ((a.y > p.y) != (b.y > p.y) &&
+			p.x < a.x + (p.y - a.y) * (b.x - a.x) / (b.y - a.y))
+			inside = !inside;
+	}
+	return inside;
+}
+
+static void regionPolygon(const std::vector<glm::vec2>& region, bool lasso, std::vector<glm::vec2>& polygon)
+{
+	if (lasso) {
+		polygon = region;
+		return;
+	}
+	polygon.resize(4);
+	polygon[0] = region[0];
+	polygon[1] = glm::vec2(region[1].x, region[0].y);
+	polygon[2] = region[1];
+	polygon[3] = glm::vec2(region[0].x, region[1].y);
+}
+
+void TrainView::selectInRegion(const std::vector<glm::vec2>& region, bool add)
+{
+	std::vector<glm::vec2> polygon;
+	regionPolygon(region, regionLasso, polygon);
+	if (!add) selectedPoints.clear();
 
-	// get the viewport - most reliable way to turn mouse coords into GL coords
+	// project the points with the camera the last frame was drawn with
+	make_current();
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	setProjection();
+	double modelview[16], projection[16];
 	int viewport[4];
 	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+	glGetDoublev(GL_PROJECTION_MATRIX, projection);
+
+	if (polygon.size() >= 3) {
+		for (unsigned int i = 0; i < m_pTrack->points.size(); i++) {
+			const Pnt3f& pos = m_pTrack->points[i].pos;
+			double wx, wy, wz;
+			if (!gluProject(pos.x, pos.y, pos.z, modelview, projection, viewport, &wx, &wy, &wz)) continue;
+			// behind the camera
+			if (wz < 0.0 || wz > 1.0) continue;
+			if (insideRegion(polygon, glm::vec2((float)wx, (float)wy)) && !isSelected(i))
+				selectedPoints.insert(std::lower_bound(selectedPoints.begin(), selectedPoints.end(), i), i);
+		}
+	}
+	if (selectedCube < 0 || !isSelected((unsigned int)selectedCube))
+		selectedCube = selectedPoints.empty() ? -1 : (int)selectedPoints[0];
+	selectionRevision++;
+	printf("Selected %u points\n", (unsigned int)selectedPoints.size());
+}
 
-	// Set up the pick matrix on the stack - remember, FlTk is
-	// upside down!
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity ();
-	gluPickMatrix((double)mx, (double)(viewport[3]-my), 
-						5, 5, viewport);
+void TrainView::pruneSelection()
+{
+	unsigned int pointsNum = (unsigned int)m_pTrack->points.size();
+	std::vector<unsigned int>::iterator end = std::lower_bound(selectedPoints.begin(), selectedPoints.end(), pointsNum);
+	if (end != selectedPoints.end()) {
+		selectedPoints.erase(end, selectedPoints.end());
+		selectionRevision++;
+	}
+	if (selectedCube >= (int)pointsNum)
+		selectedCube = selectedPoints.empty() ? -1 : (int)selectedPoints.back();
+}
 
-	// now set up the projection
-	setProjection();
+//************************************************************************
+//
+// * Undo and redo go through the same rebuild as editing, only the
+//   segments near the points they change are evaluated again
+//========================================================================
+void TrainView::undoEdit()
+{
+	if (!journal.canUndo()) {
+		printf("Nothing to undo\n");
+		return;
+	}
+	// inserts and erases move the indices, the selection means nothing then
+	if (journal.undo(m_pTrack->points))
+		selectPoint(-1, false);
+	m_pTrack->touch();
+	requestTrackSpline(false);
+	redrawScheduler.invalidate();
+}
+
+void TrainView::redoEdit()
+{
+	if (!journal.canRedo()) {
+		printf("Nothing to redo\n");
+		return;
+	}
+	if (journal.redo(m_pTrack->points))
+		selectPoint(-1, false);
+	m_pTrack->touch();
+	requestTrackSpline(false);
+	redrawScheduler.invalidate();
+}
+
+//************************************************************************
+//
+// * Saving hands a copy of the points to the saver thread, the copy is
+//   the only work done here however long the track is
+//========================================================================
+void TrainView::saveTrack(const char* fileName)
+{
+	TrackSaver::Snapshot points = std::make_shared<const std::vector<ControlPoint> >(m_pTrack->points);
+	trackSaver.save(fileName, points);
+}
+
+bool TrainView::exportTrack(const char* fileName)
+{
+	// streamed, these are empty and the file has the center line only:
+	// the whole track's meshes are what streaming avoids building
+	std::vector<GltfPart> parts;
+	parts.push_back(GltfPart("rails", trackModel, GltfPart::QUADS));
+	parts.push_back(GltfPart("sleepers", sleeperModel));
+	parts.push_back(GltfPart("supports", supportModel, GltfPart::QUADS));
+	return TrackGltf::write(fileName, m_pTrack->points, track.get(), true, parts);
+}
+
+void TrainView::autosave()
+{
+	if (m_pTrack == NULL || m_pTrack->revision == autosavedRevision) return;
+	autosavedRevision = m_pTrack->revision;
+	saveTrack(autosaveFile.c_str());
+}
 
-	// now draw the objects - but really only see what we hit
-	GLuint buf[100];
-	glSelectBuffer(100,buf);
-	glRenderMode(GL_SELECT);
-	glInitNames();
-	glPushName(0);
-
-	// draw the cubes, loading the names as we go
-	for(size_t i=0; i<m_pTrack->points.size(); ++i) {
-		glLoadName((GLuint) (i+1));
-		m_pTrack->points[i].draw();
+void TrainView::reportSaves()
+{
+	std::string fileName;
+	bool ok;
+	while (trackSaver.takeResult(fileName, ok)) {
+		if (fileName == autosaveFile) {
+			// the next change tries again, the user hears about it once
+			// until an autosave works again
+			bool failedBefore = autosaveFailed;
+			autosaveFailed = !ok;
+			if (!ok && !failedBefore)
+				fl_alert("Can't autosave to %s", fileName.c_str());
+		}
+		else if (!ok)
+			fl_alert("Can't write %s", fileName.c_str());
 	}
+}
+
+//************************************************************************
+//
+// * The box or lasso outline in window coordinates, over everything
+//========================================================================
+void TrainView::drawSelectRegion()
+{
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, w(), 0, h(), -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	glPushAttrib(GL_ENABLE_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_TEXTURE_2D);
 
-	// go back to drawing mode, and see how picking did
-	int hits = glRenderMode(GL_RENDER);
-	if (hits) {
-		// warning; this just grabs the first object hit - if there
-		// are multiple objects, you really want to pick the closest
-		// one - see the OpenGL manual 
-		// remember: we load names that are one more than the index
-		selectedCube = buf[3]-1;
-	} else // nothing hit, nothing selected
-		selectedCube = -1;
+	// straight from selectRegion, this is drawn every frame of the drag
+	glColor3ub(240, 240, 30);
+	glBegin(GL_LINE_LOOP);
+	if (regionLasso) {
+		for (size_t i = 0; i < selectRegion.size(); i++)
+			glVertex2f(selectRegion[i].x, selectRegion[i].y);
+	}
+	else {
+		glVertex2f(selectRegion[0].x, selectRegion[0].y);
+		glVertex2f(selectRegion[1].x, selectRegion[0].y);
+		glVertex2f(selectRegion[1].x, selectRegion[1].y);
+		glVertex2f(selectRegion[0].x, selectRegion[1].y);
+	}
+	glEnd();
 
-	printf("Selected Cube %d\n",selectedCube);
+	glPopAttrib();
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
 }
 
 
 void TrainView::initTrees() {
-	glm::vec3 treesPositions[] = {	glm::vec3(-83.0f, 0.0f, 37.0f),
-									glm::vec3(-62.0f, 0.0f, -69.0f),
-									glm::vec3(-27.0f, 0.0f, 24.0f),
-									glm::vec3(-4.0f, 0.0f, 0.0f),
-									glm::vec3(2.0f, 0.0f, 83.0f),
-									glm::vec3(13.0f, 0.0f, -72.0f),
-									glm::vec3(21.0f, 0.0f, 53.0f),
-									glm::vec3(39.0f, 0.0f, 46.0f),
-									glm::vec3(55.0f, 0.0f, 95.0f),
-									glm::vec3(74.0f, 0.0f, 28.0f),
-	};
-	float treesRotations[] = { 0, 40, 35, 86, 12, 138, 264, 237, 186, 311};
 	unsigned int treesNum = sizeof(treesPositions) / sizeof(glm::vec3);
 	TrainView::treeAModel->setInstanceNum(treesNum);
 	for (unsigned int treesIdx = 0; treesIdx < treesNum; treesIdx++) {
-		glm::vec3& currPos = treesPositions[treesIdx];
+		const glm::vec3& currPos = treesPositions[treesIdx];
 		glm::mat4 scale = glm::scale(glm::vec3(0.15f, 0.15f, 0.15f));
 		glm::mat4 rotate = glm::rotate(treesRotations[treesIdx], glm::vec3(0.0f, 1.0f, 0.0f));
 
-		// check if on the truck
-		for (unsigned int trackIdx = 0; trackIdx < trackSplineDirect.size(); trackIdx++) {
-			glm::mat4 trackTransform(1.0f);
-
-			trackTransform = glm::translate(-trackSplinePos[trackIdx]) * trackTransform;
-			glm::vec3 new_z = glm::normalize(trackSplineDirect[trackIdx]);
-			glm::vec3 new_y = glm::normalize(glm::vec3(0.0f, 1.0f, 0.0f));
-			glm::vec3 new_x = glm::normalize(glm::cross(new_z, new_y));
-			trackTransform = glm::mat4(
-				new_x.x, new_x.y, new_x.z, 0.0f,
-				new_y.x, new_y.y, new_y.z, 0.0f,
-				new_z.x, new_z.y, new_z.z, 0.0f,
-				0.0f, 0.0f, 0.0f, 1.0f
-			) * trackTransform;
-			trackTransform = glm::scale(glm::vec3(0.1f, 0.04f, 0.1f/glm::length(trackSplineDirect[trackIdx]))) * trackTransform;
-
-			glm::vec3 treeProj = trackTransform * glm::vec4(currPos, 1.0f);
-			treeProj = treeProj;
-			if (-1.0f < treeProj.x && treeProj.x < 1.0f &&
-				-1.0f < treeProj.y && treeProj.y < 1.0f &&
-				0.0f < treeProj.z && treeProj.z < 1.0f)
-				scale = scale * 0.0f;
-		}
+		// check if on the truck, the track builder tested it
+		if (treesIdx < treesOnTrack.size() && treesOnTrack[treesIdx])
+			scale = scale * 0.0f;
 
 		// put transforms
 		glm::mat4 transform(1.0f);
@@ -1256,70 +1534,61 @@ void TrainView::initTrees() {
 
 CaronTrack::CaronTrack(ModelClass* targetModel) {
 	CaronTrack::model = targetModel;
-	CaronTrack::trackPosition = NULL;
-	CaronTrack::trackDirect = NULL;
-	CaronTrack::trackCross = NULL;
-	CaronTrack::trackLength = NULL;
+	CaronTrack::track = NULL;
 	CaronTrack::runProcess = 0.0f;
 	CaronTrack::runSplineIdx = 0;
+	CaronTrack::runCurvature = glm::vec3(0.0f);
 }
 void CaronTrack::UpdateModel(ModelClass* targetModel) {
 	CaronTrack::model = targetModel;
 }
-void CaronTrack::UpdateTruckParameter(std::vector<glm::vec3>* positions, std::vector<glm::vec3>* directions, std::vector<glm::vec3>* crosses, std::vector<float>* lengths) {
-	CaronTrack::trackPosition = positions;
-	CaronTrack::trackDirect = directions;
-	CaronTrack::trackCross = crosses;
-	CaronTrack::trackLength = lengths;
+void CaronTrack::UpdateTruckParameter(const TrackData* track) {
+	CaronTrack::track = track;
+	// an edited track can come back shorter, Move() walks on from the start
+	if (track != NULL && runSplineIdx >= track->size())
+		runSplineIdx = 0;
 }
 void CaronTrack::ResetProcess() {
 	//CaronTrack::runProcess = 0.0f;
 	CaronTrack::runSplineIdx = 0;
 }
-void CaronTrack::Move(float distance, unsigned int instanceIdx, unsigned int interpolateMode) {
+void CaronTrack::Move(float distance, unsigned int instanceIdx) {
 	if (CaronTrack::model == NULL) return;
-	if (CaronTrack::trackPosition == NULL) return;
-	if (CaronTrack::trackDirect == NULL) return;
-	if (CaronTrack::trackCross == NULL) return;
-	if (CaronTrack::trackLength == NULL) return;
+	if (CaronTrack::track == NULL) return;
+	if (CaronTrack::track->empty()) return;
 
+	const std::vector<float>& trackLength = track->lengths();
 	runProcess = runProcess + distance;
-	while (runProcess < 0) runProcess += (*trackLength)[trackLength->size()-1];
-	runProcess = fmod(runProcess, (*trackLength)[trackLength->size() - 1]);
+	while (runProcess < 0) runProcess += trackLength[trackLength.size()-1];
+	runProcess = fmod(runProcess, trackLength[trackLength.size() - 1]);
 	float begLen, endLen;
 	if (distance >= 0) {
 		while (1) {
-			begLen = (runSplineIdx == 0) ? 0 : (*trackLength)[runSplineIdx - 1];
-			endLen = (*trackLength)[runSplineIdx];
+			begLen = (runSplineIdx == 0) ? 0 : trackLength[runSplineIdx - 1];
+			endLen = trackLength[runSplineIdx];
 			if (begLen <= runProcess && runProcess <= endLen) break;
-			runSplineIdx = (runSplineIdx + 1) % trackLength->size();
+			runSplineIdx = (runSplineIdx + 1) % trackLength.size();
 		}
 
 	}
 	else {
 		while (1) {
-			begLen = (runSplineIdx == 0) ? 0 : (*trackLength)[runSplineIdx - 1];
-			endLen = (*trackLength)[runSplineIdx];
+			begLen = (runSplineIdx == 0) ? 0 : trackLength[runSplineIdx - 1];
+			endLen = trackLength[runSplineIdx];
 			if (begLen <= runProcess && runProcess <= endLen) break;
-			runSplineIdx = (runSplineIdx == 0) ? trackLength->size() - 1 : runSplineIdx - 1;
+			runSplineIdx = (runSplineIdx == 0) ? trackLength.size() - 1 : runSplineIdx - 1;
 		}
 	}
 
 	float t = (runProcess - begLen) / (endLen - begLen);
 
-	glm::vec3 modelPos, modelCross, modleDirect;
-	//if (interpolateMode == 1) {
-	//float l = (*trackLength)[runSplineIdx];
-	if (interpolateMode == 1) {
-		modelPos = (1 - t) * (*trackPosition)[runSplineIdx] + t * (*trackPosition)[(runSplineIdx + 1) % trackPosition->size()];
-		modelCross = (1 - t) * (*trackCross)[runSplineIdx] + t * (*trackCross)[(runSplineIdx + 1) % trackCross->size()];
-		modleDirect = (1 - t) * (*trackDirect)[runSplineIdx] + t * (*trackDirect)[(runSplineIdx + 1) % trackDirect->size()];
-	}
-	else {
-		modelPos = (1 - t) * (*trackPosition)[runSplineIdx] + t * (*trackPosition)[(runSplineIdx + 1) % trackPosition->size()];
-		modelCross = (1 - t) * (*trackCross)[runSplineIdx] + t * (*trackCross)[(runSplineIdx + 1) % trackCross->size()];
-		modleDirect = (*trackDirect)[runSplineIdx];
-	}
+	// the direction is the spline's own, turned by its curvature along the
+	// sample, so it is smooth on curves and doesn't swing on straight lines
+	unsigned int nextIdx = (runSplineIdx + 1) % track->size();
+	glm::vec3 modelPos = (1 - t) * track->position(runSplineIdx) + t * track->position(nextIdx);
+	glm::vec3 modelCross = (1 - t) * track->cross(runSplineIdx) + t * track->cross(nextIdx);
+	glm::vec3 modleDirect = track->tangentAt(runSplineIdx, runProcess - begLen);
+	CaronTrack::runCurvature = track->curvature(runSplineIdx);
 
 	glm::mat4 transform = glm::mat4(1.0f);
 	transform = glm::scale(glm::vec3(0.15f, 0.15f, 0.15f)) * transform;
@@ -1348,6 +1617,9 @@ float CaronTrack::GetProcess() {
 unsigned int CaronTrack::GetIndex() {
 	return CaronTrack::runSplineIdx;
 }
+glm::vec3 CaronTrack::GetCurvature() {
+	return CaronTrack::runCurvature;
+}
 void CaronTrack::SetProcess(float val) {
 	CaronTrack::runProcess = val;
 }
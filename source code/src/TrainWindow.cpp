@@ -63,6 +63,7 @@ TrainWindow(const int x, const int y)
 
 		runButton = new Fl_Button(605,pty,60,20,"Run");
 		togglify(runButton);
+		runButton->callback((Fl_Callback*)runCB,this);
 
 		Fl_Button* fb = new Fl_Button(700,pty,25,20,"@>>");
 		fb->callback((Fl_Callback*)forwCB,this);
@@ -197,6 +198,12 @@ TrainWindow(const int x, const int y)
 		SunDegree2->type(FL_HORIZONTAL);
 		SunDegree2->callback((Fl_Callback*)trainViewRedraw, this);
 
+		pty += 30;
+		shadowMapButton = new Fl_Button(605, pty, 100, 20, "Shadow Map");
+		shadowMapButton->type(FL_TOGGLE_BUTTON);
+		shadowMapButton->selection_color((Fl_Color)3);
+		shadowMapButton->callback((Fl_Callback*)trainViewRedraw, this);
+
 
 		pty += 30;
 
@@ -206,7 +213,6 @@ TrainWindow(const int x, const int y)
 #endif
 		trainView->updateTrackSpline();
 		trainView->trainMove(0.0f);
-		prevSpeed = 0;
 
 		// we need to make a little phantom widget to have things resize correctly
 		Fl_Box* resizebox = new Fl_Box(600,595,200,5);
@@ -216,8 +222,8 @@ TrainWindow(const int x, const int y)
 	}
 	end();	// done adding to this widget
 
-	// set up callback on idle
-	Fl::add_timeout(1.0 / 30.0, (Fl_Timeout_Handler)runTimerCB, (void*)this);
+	// the run timer is started by the run button, a stopped train
+	// doesn't wake the program up at all
 	//Fl::add_idle((void (*)(void*))runButtonCB,this);
 
 }
@@ -244,15 +250,13 @@ void TrainWindow::
 damageMe()
 //========================================================================
 {
-	if (trainView->selectedCube >= ((int)m_Track.points.size()))
-		trainView->selectedCube = 0;
-	trainView->damage(1);
+	trainView->pruneSelection();
+	trainView->redrawScheduler.invalidate();
 }
 
 //************************************************************************
 //
-// * This will get called (approximately) 30 times per second
-//   if the run button is pressed
+// * Move the train one step, forward/back buttons use mode 1
 //========================================================================
 void TrainWindow::
 advanceTrain(float dir, int mode, float DeltaTime)
@@ -276,61 +280,32 @@ advanceTrain(float dir, int mode, float DeltaTime)
 	if (world.trainU > nct) world.trainU -= nct;
 	if (world.trainU < 0) world.trainU += nct;
 #endif
-	if (mode == 1) {
-		trainView->trainMove(dir* 5);
-		return;
-	}
-
-	if (mode == 0) {
-		if (arcLength->value()) {
-			float targetSpeed = speed->value() / 30.0f * dir;
-			float nowSpeed = targetSpeed;
-			if (physicsButton->value()) {
-
-				float slop = glm::normalize(trainView->trainModel->directions[0]).y;
-				float force = targetSpeed * 10.0f;
-				if (speed->value() == 0.0f)//brakes
-					force = signbit(prevSpeed) ? 2.0f: -2.0f;
-				float gravity = 0.98f;
-				float mass = 40.0f;
-				float drag = prevSpeed * 10.0f;
-				float totalForce = force - gravity * mass * slop - drag;
-
-				float acc = totalForce / mass;
-
-				//if (speed->value() == 0.0f) {//brakes
-				//	if (acc < 0 && (-acc) > prevSpeed)	nowSpeed = 0.0f;
-				//	else if (acc > 0 && acc < (-prevSpeed))	nowSpeed = 0.0f;
-				//	else nowSpeed = prevSpeed + acc * DeltaTime;
-				//}
-				//else {
-				//	nowSpeed = prevSpeed + acc * DeltaTime;
-				//}
-				nowSpeed = prevSpeed + acc * DeltaTime;
-				prevSpeed = nowSpeed;
-			}
-			else {
-				nowSpeed = targetSpeed;
-			}
-
-			trainView->trainMove(nowSpeed);
-			prevSpeed = nowSpeed;
-		}
-		else {
-			float moveLength = glm::length(trainView->trackSplineDirect[trainView->trainControl->GetIndex()]);
-			trainView->trainMove(moveLength * speed->value() * dir * DeltaTime);
-
-			if (physicsButton->value()) {
-				physicsButton->value(0);
-			}
-		}
-	}
-	trainView->smokeAnimation->timeAdd(DeltaTime);
-	if ((clock() - lastSmokeTime) > (5000 / speed->value())) {
-		lastSmokeTime = clock();
-		if (smokeButton->value()) {
+	// the train really moves on the simulation thread (Simulation::advance),
+	// this only passes the request on. when nothing started that thread
+	// the tick runs right here
+	pushSimControls();
+	if (mode == 1)
+		trainView->trainMove(dir * 5);
+	if (!trainView->simulation.isStarted())
+		trainView->simulation.step(mode == 0 ? DeltaTime : 0.0f);
+}
 
-			trainView->smokeAnimation->addInstance(trainView->trainModel->transforms[0]);
-		}
-	}
+//************************************************************************
+//
+// * Copy the widgets the simulation looks at into its atomics
+//========================================================================
+void TrainWindow::
+pushSimControls()
+//========================================================================
+{
+	// speeds without arc length parameterization don't do physics
+	if (runButton->value() && !arcLength->value() && physicsButton->value())
+		physicsButton->value(0);
+
+	Simulation& simulation = trainView->simulation;
+	simulation.running = runButton->value() != 0;
+	simulation.speed = (float)speed->value();
+	simulation.arcLength = arcLength->value() != 0;
+	simulation.physics = physicsButton->value() != 0;
+	simulation.smoke = smokeButton->value() != 0;
 }
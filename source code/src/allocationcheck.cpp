@@ -0,0 +1,43 @@
+#include "allocationcheck.h"
+
+#ifdef _DEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+static thread_local unsigned long allocationNum = 0;
+
+// the other forms of new and delete (arrays, nothrow) end up in these
+void* operator new(size_t size) {
+	allocationNum++;
+	void* p = malloc(size ? size : 1);
+	if (p == NULL) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+AllocationCheck::AllocationCheck(const char* what) {
+	AllocationCheck::what = what;
+	AllocationCheck::start = allocationNum;
+}
+
+void AllocationCheck::verify(bool steady) {
+	unsigned long made = allocationNum - start;
+	if (steady && made > 0)
+		fprintf(stderr, "%s allocated %lu times\n", what, made);
+	assert(!steady || made == 0);
+	start = allocationNum;
+}
+
+unsigned long AllocationCheck::count() {
+	return allocationNum;
+}
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+// Counts the heap allocations each thread makes, in debug builds (_DEBUG)
+// only, so the code that runs every frame can assert it allocates nothing:
+// an allocation there is a hitch waiting for a busy heap. Construct one at
+// the start of the code to watch and call verify() at its end. Release
+// builds leave the global operator new alone and the checks compile away.
+#ifdef _DEBUG
+class AllocationCheck {
+public:
+	AllocationCheck(const char* what);
+	// asserts nothing was allocated on this thread since construction,
+	// only when steady (a frame that had to build something may allocate)
+	void verify(bool steady = true);
+	// allocations on this thread so far
+	static unsigned long count();
+private:
+	const char* what;
+	unsigned long start;
+};
+#else
+class AllocationCheck {
+public:
+	AllocationCheck(const char*) {}
+	void verify(bool = true) {}
+	static unsigned long count() { return 0; }
+};
+#endif
@@ -0,0 +1,57 @@
+#include "atomicfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+AtomicFile::AtomicFile() {
+	AtomicFile::fp = NULL;
+}
+
+AtomicFile::~AtomicFile() {
+	abandon();
+}
+
+bool AtomicFile::open(const char* fileName, bool binary) {
+	abandon();
+	target = fileName;
+	temp = target + ".tmp";
+	fp = fopen(temp.c_str(), binary ? "wb" : "w");
+	return fp != NULL;
+}
+
+FILE* AtomicFile::stream() {
+	return fp;
+}
+
+bool AtomicFile::commit() {
+	if (fp == NULL) return false;
+	bool ok = fflush(fp) == 0 && !ferror(fp);
+	// on the disk before the rename makes it the file
+#ifdef _WIN32
+	if (ok) ok = _commit(_fileno(fp)) == 0;
+#else
+	if (ok) ok = fsync(fileno(fp)) == 0;
+#endif
+	if (fclose(fp) != 0) ok = false;
+	fp = NULL;
+	if (ok) {
+#ifdef _WIN32
+		ok = MoveFileExA(temp.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		ok = rename(temp.c_str(), target.c_str()) == 0;
+#endif
+	}
+	if (!ok) remove(temp.c_str());
+	return ok;
+}
+
+void AtomicFile::abandon() {
+	if (fp == NULL) return;
+	fclose(fp);
+	fp = NULL;
+	remove(temp.c_str());
+}
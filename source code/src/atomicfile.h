@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdio.h>
+#include <string>
+
+// Writes a file so a crash or a full disk never leaves half of it behind.
+// Everything goes to a temporary file next to the target, which is flushed
+// to the disk and then renamed over the target in one step (MoveFileEx on
+// Windows, rename elsewhere). Readers see the old file or the new one.
+class AtomicFile {
+public:
+	AtomicFile();
+	// an uncommitted file is thrown away
+	~AtomicFile();
+	// start writing fileName, false if the temporary file can't be made
+	bool open(const char* fileName, bool binary = false);
+	FILE* stream();
+	// flush, sync and put the new file in place. false leaves the old one
+	bool commit();
+	void abandon();
+private:
+	AtomicFile(const AtomicFile&);
+	AtomicFile& operator=(const AtomicFile&);
+private:
+	std::string target;
+	std::string temp;
+	FILE* fp;
+};
@@ -0,0 +1,32 @@
+#include "displaylist.h"
+
+DisplayList::DisplayList() {
+	DisplayList::list = 0;
+	DisplayList::recorded = false;
+	DisplayList::revision = 0;
+	DisplayList::variant = 0;
+}
+
+DisplayList::~DisplayList() {
+}
+
+bool DisplayList::begin(unsigned long revision, int variant) {
+	if (recorded && revision == DisplayList::revision && variant == DisplayList::variant) {
+		glCallList(list);
+		return false;
+	}
+
+	if (list == 0)
+		list = glGenLists(1);
+	DisplayList::revision = revision;
+	DisplayList::variant = variant;
+	// plain compile and a call afterwards, compile-and-execute is slow on some drivers
+	glNewList(list, GL_COMPILE);
+	return true;
+}
+
+void DisplayList::end() {
+	glEndList();
+	recorded = true;
+	glCallList(list);
+}
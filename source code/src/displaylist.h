@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// A display list that is recorded once and replayed until the revision it
+// was recorded for changes. For geometry that stays put over many frames,
+// so the driver keeps it instead of the program re-sending every vertex.
+// variant tells apart small states that change what gets drawn (which
+// camera is on, which point is selected, ...) without a new revision.
+class DisplayList {
+private:
+	GLuint list;
+	bool recorded;
+	unsigned long revision;
+	int variant;
+public:
+	DisplayList();
+	// the list goes away with the context of the window that drew it
+	~DisplayList();
+	// replays the list and returns false when it is up to date. otherwise
+	// starts recording and returns true, draw the geometry then call end()
+	bool begin(unsigned long revision, int variant = 0);
+	// finish recording and draw what was recorded
+	void end();
+private:
+	DisplayList(const DisplayList&);
+	DisplayList& operator=(const DisplayList&);
+};
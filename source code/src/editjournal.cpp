@@ -0,0 +1,138 @@
+#include "editjournal.h"
+
+EditJournal::EditJournal(unsigned int deltaCapacity, unsigned int editCapacity) {
+	EditJournal::deltaCapacity = deltaCapacity;
+	EditJournal::editCapacity = editCapacity;
+	clear();
+}
+
+void EditJournal::clear() {
+	EditJournal::deltaBegin = EditJournal::deltaEnd = 0;
+	EditJournal::editBegin = EditJournal::editEnd = EditJournal::editCursor = 0;
+}
+
+PointDelta& EditJournal::delta(unsigned long idx) {
+	return deltas[idx % deltaCapacity];
+}
+
+EditJournal::Edit& EditJournal::edit(unsigned long idx) {
+	return edits[idx % editCapacity];
+}
+
+void EditJournal::record(const std::vector<PointDelta>& newDeltas, unsigned long coalesce) {
+	if (newDeltas.empty()) return;
+	// a new edit ends what could be redone
+	if (editCursor < editEnd) {
+		editEnd = editCursor;
+		deltaEnd = (editEnd > editBegin) ? edit(editEnd - 1).first + edit(editEnd - 1).count : deltaBegin;
+	}
+	if (fold(newDeltas, coalesce)) return;
+
+	// too big to keep at all, and the edits before it can't be undone
+	// past it either
+	if (newDeltas.size() > deltaCapacity) {
+		clear();
+		return;
+	}
+	if (deltas.empty()) {
+		deltas.resize(deltaCapacity);
+		edits.resize(editCapacity);
+	}
+	while (editEnd - editBegin >= editCapacity || deltaEnd - deltaBegin + newDeltas.size() > deltaCapacity)
+		dropOldest();
+
+	Edit& newEdit = edit(editEnd);
+	newEdit.first = deltaEnd;
+	newEdit.count = (unsigned int)newDeltas.size();
+	newEdit.coalesce = coalesce;
+	newEdit.structural = false;
+	for (unsigned int i = 0; i < newDeltas.size(); i++) {
+		delta(deltaEnd++) = newDeltas[i];
+		if (newDeltas[i].kind != PointDelta::CHANGE) newEdit.structural = true;
+	}
+	editEnd++;
+	editCursor = editEnd;
+}
+
+// only changes fold, each into the delta of the same point: its before
+// stays, its after is the new one
+bool EditJournal::fold(const std::vector<PointDelta>& newDeltas, unsigned long coalesce) {
+	if (coalesce == 0 || editEnd == editBegin) return false;
+	Edit& last = edit(editEnd - 1);
+	if (last.coalesce != coalesce || last.structural) return false;
+	for (unsigned int i = 0; i < newDeltas.size(); i++)
+		if (newDeltas[i].kind != PointDelta::CHANGE) return false;
+
+	for (unsigned int i = 0; i < newDeltas.size(); i++) {
+		const PointDelta& newDelta = newDeltas[i];
+		// a drag changes the same points in the same order every time
+		unsigned long found = deltaEnd;
+		if (i < last.count && delta(last.first + i).index == newDelta.index)
+			found = last.first + i;
+		for (unsigned long j = last.first; j < last.first + last.count && found == deltaEnd; j++)
+			if (delta(j).index == newDelta.index) found = j;
+		if (found != deltaEnd) {
+			delta(found).after = newDelta.after;
+			continue;
+		}
+		// a point the edit didn't have yet, the newest edit ends the ring
+		if (deltaEnd - deltaBegin >= deltaCapacity) {
+			if (editEnd - editBegin == 1) {
+				clear();
+				return true;
+			}
+			dropOldest();
+		}
+		delta(deltaEnd++) = newDelta;
+		last.count++;
+	}
+	return true;
+}
+
+void EditJournal::dropOldest() {
+	editBegin++;
+	if (editCursor < editBegin) editCursor = editBegin;
+	deltaBegin = (editBegin < editEnd) ? edit(editBegin).first : deltaEnd;
+}
+
+bool EditJournal::canUndo() {
+	return editCursor > editBegin;
+}
+
+bool EditJournal::canRedo() {
+	return editCursor < editEnd;
+}
+
+bool EditJournal::undo(std::vector<ControlPoint>& points) {
+	if (!canUndo()) return false;
+	Edit& last = edit(--editCursor);
+	for (unsigned long i = last.first + last.count; i > last.first; i--) {
+		const PointDelta& d = delta(i - 1);
+		if (d.kind == PointDelta::CHANGE)
+			points[d.index] = d.before;
+		else if (d.kind == PointDelta::INSERT)
+			points.erase(points.begin() + d.index);
+		else
+			points.insert(points.begin() + d.index, d.before);
+	}
+	return last.structural;
+}
+
+bool EditJournal::redo(std::vector<ControlPoint>& points) {
+	if (!canRedo()) return false;
+	Edit& next = edit(editCursor++);
+	for (unsigned long i = next.first; i < next.first + next.count; i++) {
+		const PointDelta& d = delta(i);
+		if (d.kind == PointDelta::CHANGE)
+			points[d.index] = d.after;
+		else if (d.kind == PointDelta::INSERT)
+			points.insert(points.begin() + d.index, d.after);
+		else
+			points.erase(points.begin() + d.index);
+	}
+	return next.structural;
+}
+
+size_t EditJournal::memoryUsed() {
+	return deltas.size() * sizeof(PointDelta) + edits.size() * sizeof(Edit);
+}
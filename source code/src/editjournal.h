@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ControlPoint.H"
+
+#include <vector>
+#include <stddef.h>
+
+// one control point before and after an edit. an INSERT has no before and
+// an ERASE no after, indices are as they were when the delta was made
+struct PointDelta {
+	enum Kind { CHANGE, INSERT, ERASE };
+	unsigned int index;
+	unsigned char kind;
+	ControlPoint before;
+	ControlPoint after;
+};
+
+// Undo and redo for the control points, kept as the points each edit
+// changed rather than copies of the whole track. The deltas sit in one
+// ring of fixed size and the edits (runs of deltas) in another; when
+// either is full the oldest edits are dropped. An edit recorded with the
+// same non-zero coalesce key as the newest one is folded into it, so a
+// whole mouse drag undoes in one step.
+class EditJournal {
+public:
+	EditJournal(unsigned int deltaCapacity = 1 << 15, unsigned int editCapacity = 256);
+	// the deltas of one edit, in the order they were made. anything that
+	// could have been redone is dropped
+	void record(const std::vector<PointDelta>& deltas, unsigned long coalesce = 0);
+	bool canUndo();
+	bool canRedo();
+	// step back or forward one edit on points, returns true when points
+	// were inserted or erased (indices moved)
+	bool undo(std::vector<ControlPoint>& points);
+	bool redo(std::vector<ControlPoint>& points);
+	void clear();
+	// bytes held by the deltas ring
+	size_t memoryUsed();
+private:
+	struct Edit {
+		unsigned long first;	// counted over all deltas ever kept
+		unsigned int count;
+		unsigned long coalesce;
+		bool structural;		// has inserts or erases
+	};
+	PointDelta& delta(unsigned long idx);
+	Edit& edit(unsigned long idx);
+	// true when the deltas could go into the newest edit
+	bool fold(const std::vector<PointDelta>& newDeltas, unsigned long coalesce);
+	void dropOldest();
+
+	unsigned int deltaCapacity;
+	unsigned int editCapacity;
+	std::vector<PointDelta> deltas;	// grown to deltaCapacity on first use
+	std::vector<Edit> edits;
+	// kept deltas and edits are [begin, end), counted over everything ever
+	// kept; edits before cursor are done, the ones after it can be redone
+	unsigned long deltaBegin, deltaEnd;
+	unsigned long editBegin, editEnd, editCursor;
+};
@@ -23,7 +23,10 @@
 *************************************************************************/
 
 #include "stdio.h"
+#include "string.h"
 #include "TrainWindow.H"
+#include "TrainView.H"
+#include "trackbundle.h"
 
 #pragma warning(push)
 #pragma warning(disable:4312)
@@ -32,10 +35,21 @@
 #pragma warning(pop)
 
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
+	// RollerCoasters --bake ... builds a track into a bundle, no window
+	if (argc > 1 && strcmp(argv[1], "--bake") == 0) {
+		std::vector<glm::vec3> trees;
+		TrainView::treePositions(trees);
+		return TrackBundle::runBaker(argc - 2, argv + 2, trees);
+	}
+
 	printf("CS559 Train Assignment\n");
+	// the model loader threads wake the UI up with Fl::awake
+	Fl::lock();
 	TrainWindow tw;
+	// the train moves on its own thread from now on
+	tw.trainView->simulation.start();
 	tw.show();
 
 	Fl::run();
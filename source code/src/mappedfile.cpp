@@ -0,0 +1,88 @@
+#include "mappedfile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {
+	MappedFile::base = NULL;
+	MappedFile::length = 0;
+#ifdef _WIN32
+	MappedFile::file = INVALID_HANDLE_VALUE;
+	MappedFile::mapping = NULL;
+#else
+	MappedFile::fd = -1;
+#endif
+}
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::open(const char* fileName) {
+	close();
+#ifdef _WIN32
+	file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		close();
+		return false;
+	}
+	base = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (base == NULL) {
+		close();
+		return false;
+	}
+	length = (size_t)fileSize.QuadPart;
+#else
+	fd = ::open(fileName, O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close();
+		return false;
+	}
+	void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED) {
+		close();
+		return false;
+	}
+	base = (const unsigned char*)view;
+	length = (size_t)st.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+	if (base != NULL) UnmapViewOfFile(base);
+	if (mapping != NULL) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (base != NULL) munmap((void*)base, length);
+	if (fd >= 0) ::close(fd);
+	fd = -1;
+#endif
+	base = NULL;
+	length = 0;
+}
+
+bool MappedFile::isOpen() const {
+	return base != NULL;
+}
+const unsigned char* MappedFile::data() const {
+	return base;
+}
+size_t MappedFile::size() const {
+	return length;
+}
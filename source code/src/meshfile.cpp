@@ -0,0 +1,198 @@
+// Compiled binary mesh files.
+//
+// "models/train.obj" is compiled to "models/train.obj.bin" the first time it
+// is loaded. The binary holds the welded interleaved vertices, the index
+// buffer, the per-mesh index ranges and the bounds, so later runs only have to
+// map the file instead of parsing text. The header remembers the size, the
+// modification time and a hash of the OBJ it was built from; the binary is
+// used if the time still matches or, when only the time changed (e.g. a fresh
+// checkout), if the hash of the source still matches.
+#include "model.h"
+#include "atomicfile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdint.h>
+
+static const char MESH_FILE_MAGIC[4] = { 'R', 'C', 'M', 'B' };
+static const uint32_t MESH_FILE_VERSION = 2;
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceTime;
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+	uint32_t meshNum;
+	uint32_t vertexNum;
+	uint32_t indexNum;
+	uint32_t vertexSize;
+	float boundsMin[3];
+	float boundsMax[3];
+}MeshFileHeader;
+
+static_assert(sizeof(MeshVertex) == 6 * sizeof(float), "MeshVertex must be tightly packed");
+static_assert(sizeof(Mesh) == 2 * sizeof(uint32_t), "Mesh must be two 32 bit values");
+static_assert(sizeof(MeshFileHeader) % 4 == 0, "mesh data after the header must stay 4 byte aligned");
+
+static std::string meshFileName(const char* objFileName) {
+	return std::string(objFileName) + ".bin";
+}
+
+static bool sourceStamp(const char* fileName, uint64_t& time, uint64_t& size) {
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(fileName, &st) != 0) return false;
+#else
+	struct stat st;
+	if (stat(fileName, &st) != 0) return false;
+#endif
+	time = (uint64_t)st.st_mtime;
+	size = (uint64_t)st.st_size;
+	return true;
+}
+
+// 64 bit FNV-1a over the whole source file
+static bool sourceHash(const char* fileName, uint64_t& hash) {
+	MappedFile source;
+	if (!source.open(fileName)) return false;
+	hash = 14695981039346656037ull;
+	const unsigned char* bytes = source.data();
+	for (size_t i = 0; i < source.size(); i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return true;
+}
+
+// every mesh range must lie in the index buffer and every index must name
+// a vertex, the draw calls read whatever a stale or damaged file says
+static bool meshTablesValid(const MappedFile& file, size_t offset, const MeshFileHeader& header) {
+	const unsigned char* data = file.data() + offset + sizeof(MeshFileHeader);
+	const Mesh* meshTable = (const Mesh*)data;
+	for (uint32_t i = 0; i < header.meshNum; i++)
+		if (meshTable[i].firstIndex > header.indexNum || meshTable[i].indexNum > header.indexNum - meshTable[i].firstIndex)
+			return false;
+	data += (size_t)header.meshNum * sizeof(Mesh) + (size_t)header.vertexNum * sizeof(MeshVertex);
+	const uint32_t* indices = (const uint32_t*)data;
+	for (uint32_t i = 0; i < header.indexNum; i++)
+		if (indices[i] >= header.vertexNum) return false;
+	return true;
+}
+
+// the header of a mesh at offset, its tables must fit in the file and hold
+// together. size is the whole mesh, header and tables
+static bool readMeshHeader(const MappedFile& file, size_t offset, MeshFileHeader& header, size_t& size) {
+	if (offset % 4 != 0 || file.size() < offset || file.size() - offset < sizeof(MeshFileHeader)) return false;
+	memcpy(&header, file.data() + offset, sizeof(header));
+	size = sizeof(MeshFileHeader) + (size_t)header.meshNum * sizeof(Mesh) +
+		(size_t)header.vertexNum * sizeof(MeshVertex) + (size_t)header.indexNum * sizeof(uint32_t);
+	return memcmp(header.magic, MESH_FILE_MAGIC, 4) == 0 &&
+		header.version == MESH_FILE_VERSION &&
+		header.vertexSize == sizeof(MeshVertex) &&
+		file.size() - offset >= size &&
+		meshTablesValid(file, offset, header);
+}
+
+int MeshData::loadMeshFile(const char* objFileName) {
+	uint64_t time, size;
+	if (!sourceStamp(objFileName, time, size)) return -1;
+
+	MappedFile& file = MeshData::mapping;
+	if (!file.open(meshFileName(objFileName).c_str())) return -1;
+
+	MeshFileHeader header;
+	size_t meshSize;
+	bool valid = readMeshHeader(file, 0, header, meshSize) &&
+		header.sourceSize == size &&
+		file.size() == meshSize;
+	if (valid && header.sourceTime != time) {
+		uint64_t hash;
+		valid = sourceHash(objFileName, hash) && hash == header.sourceHash;
+	}
+	if (!valid) {
+		file.close();
+		return -1;
+	}
+	useMapping(0);
+	return 0;
+}
+
+int MeshData::loadMeshSection(const char* fileName, size_t offset) {
+	MappedFile& file = MeshData::mapping;
+	if (!file.open(fileName)) return -1;
+	MeshFileHeader header;
+	size_t meshSize;
+	if (!readMeshHeader(file, offset, header, meshSize)) {
+		file.close();
+		return -1;
+	}
+	useMapping(offset);
+	return 0;
+}
+
+void MeshData::useMapping(size_t offset) {
+	MeshFileHeader header;
+	memcpy(&header, MeshData::mapping.data() + offset, sizeof(header));
+	const unsigned char* data = MeshData::mapping.data() + offset + sizeof(MeshFileHeader);
+	const Mesh* meshTable = (const Mesh*)data;
+	data += header.meshNum * sizeof(Mesh);
+	MeshData::meshes.assign(meshTable, meshTable + header.meshNum);
+	MeshData::vertices = (const MeshVertex*)data;
+	MeshData::vertexNum = header.vertexNum;
+	data += header.vertexNum * sizeof(MeshVertex);
+	MeshData::indices = (const unsigned int*)data;
+	MeshData::indexNum = header.indexNum;
+	MeshData::boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	MeshData::boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+
+	// the mapping now owns the data
+	MeshData::vertexStorage.clear();
+	MeshData::indexStorage.clear();
+}
+
+// the header (its source fields already filled in) and the tables
+static bool writeMesh(FILE* fp, const MeshData& mesh, MeshFileHeader& header) {
+	memcpy(header.magic, MESH_FILE_MAGIC, 4);
+	header.version = MESH_FILE_VERSION;
+	header.meshNum = (uint32_t)mesh.meshes.size();
+	header.vertexNum = mesh.vertexNum;
+	header.indexNum = mesh.indexNum;
+	header.vertexSize = sizeof(MeshVertex);
+	for (int i = 0; i < 3; i++) {
+		header.boundsMin[i] = mesh.boundsMin[i];
+		header.boundsMax[i] = mesh.boundsMax[i];
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (ok && header.meshNum) ok = fwrite(&mesh.meshes[0], sizeof(Mesh), header.meshNum, fp) == header.meshNum;
+	if (ok && header.vertexNum) ok = fwrite(mesh.vertices, sizeof(MeshVertex), header.vertexNum, fp) == header.vertexNum;
+	if (ok && header.indexNum) ok = fwrite(mesh.indices, sizeof(uint32_t), header.indexNum, fp) == header.indexNum;
+	return ok;
+}
+
+int MeshData::writeMeshFile(const char* objFileName) const {
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	if (!sourceStamp(objFileName, header.sourceTime, header.sourceSize)) return -1;
+	if (!sourceHash(objFileName, header.sourceHash)) return -1;
+
+	// replaced in one step, a crash while writing leaves no torn file
+	AtomicFile file;
+	if (!file.open(meshFileName(objFileName).c_str(), true)) return -1;
+	if (!writeMesh(file.stream(), *this, header)) return -1;
+	return file.commit() ? 0 : -1;
+}
+
+// no source to check against, the source fields stay zero so the same mesh
+// always writes the same bytes
+int MeshData::writeMeshSection(FILE* fp, size_t& size) const {
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	if (!writeMesh(fp, *this, header)) return -1;
+	size = sizeof(MeshFileHeader) + (size_t)header.meshNum * sizeof(Mesh) +
+		(size_t)header.vertexNum * sizeof(MeshVertex) + (size_t)header.indexNum * sizeof(uint32_t);
+	return 0;
+}
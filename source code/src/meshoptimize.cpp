@@ -0,0 +1,154 @@
+// Load time mesh optimization.
+//
+// weldVertices() merges corners that share both position and normal, so the
+// de-indexed OBJ data turns into a real indexed mesh. optimizeVertexCache()
+// then reorders the triangles of every mesh with Tipsify (Sander, Nehab and
+// Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+// Overdraw", 2007) so consecutive triangles reuse the vertices the GPU has
+// just transformed, and renumbers the vertices in the order they are first
+// used so vertex fetches walk memory forward.
+#include "model.h"
+
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+	struct VertexHash {
+		size_t operator()(const MeshVertex& vertex) const {
+			const unsigned char* bytes = (const unsigned char*)&vertex;
+			size_t hash = 2166136261u;
+			for (unsigned int i = 0; i < sizeof(MeshVertex); i++) {
+				hash ^= bytes[i];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+	};
+	struct VertexEqual {
+		bool operator()(const MeshVertex& a, const MeshVertex& b) const {
+			return memcmp(&a, &b, sizeof(MeshVertex)) == 0;
+		}
+	};
+}
+
+void MeshData::weldVertices() {
+	std::unordered_map<MeshVertex, unsigned int, VertexHash, VertexEqual> unique;
+	unique.reserve(MeshData::vertexStorage.size());
+	std::vector<MeshVertex> welded;
+	welded.reserve(MeshData::vertexStorage.size());
+
+	for (unsigned int i = 0; i < MeshData::indexStorage.size(); i++) {
+		const MeshVertex& vertex = MeshData::vertexStorage[MeshData::indexStorage[i]];
+		std::pair<std::unordered_map<MeshVertex, unsigned int, VertexHash, VertexEqual>::iterator, bool> inserted =
+			unique.insert(std::make_pair(vertex, (unsigned int)welded.size()));
+		if (inserted.second) welded.push_back(vertex);
+		MeshData::indexStorage[i] = inserted.first->second;
+	}
+	MeshData::vertexStorage.swap(welded);
+}
+
+void MeshData::optimizeVertexCache(unsigned int cacheSize) {
+	const unsigned int vertexCount = (unsigned int)MeshData::vertexStorage.size();
+	if (vertexCount == 0) return;
+
+	std::vector<unsigned int> reordered(MeshData::indexStorage.size());
+	std::vector<unsigned int> adjacencyOffset(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<int> liveTriangles(vertexCount);
+	std::vector<int> cacheTime(vertexCount);
+	std::vector<unsigned char> emitted;
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+
+	for (unsigned int meshIdx = 0; meshIdx < MeshData::meshes.size(); meshIdx++) {
+		const Mesh& currMesh = MeshData::meshes[meshIdx];
+		const unsigned int* meshIndices = &MeshData::indexStorage[currMesh.firstIndex];
+		unsigned int* output = &reordered[currMesh.firstIndex];
+		const unsigned int triangleNum = currMesh.indexNum / 3;
+		if (triangleNum == 0) continue;
+
+		// vertex -> triangles adjacency, counting sort style
+		std::fill(liveTriangles.begin(), liveTriangles.end(), 0);
+		for (unsigned int i = 0; i < triangleNum * 3; i++)
+			liveTriangles[meshIndices[i]]++;
+		adjacencyOffset[0] = 0;
+		for (unsigned int v = 0; v < vertexCount; v++)
+			adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+		adjacency.resize(triangleNum * 3);
+		std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for (unsigned int t = 0; t < triangleNum; t++)
+			for (unsigned int c = 0; c < 3; c++)
+				adjacency[fill[meshIndices[3 * t + c]]++] = t;
+
+		std::fill(cacheTime.begin(), cacheTime.end(), 0);
+		emitted.assign(triangleNum, 0);
+		deadEnd.clear();
+
+		int timeStamp = (int)cacheSize + 1;
+		unsigned int cursor = 0;
+		unsigned int outputIdx = 0;
+		int fanning = (int)meshIndices[0];
+		while (fanning >= 0) {
+			candidates.clear();
+			for (unsigned int a = adjacencyOffset[fanning]; a < adjacencyOffset[fanning + 1]; a++) {
+				unsigned int t = adjacency[a];
+				if (emitted[t]) continue;
+				for (unsigned int c = 0; c < 3; c++) {
+					unsigned int v = meshIndices[3 * t + c];
+					output[outputIdx++] = v;
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					liveTriangles[v]--;
+					if (timeStamp - cacheTime[v] > (int)cacheSize)
+						cacheTime[v] = timeStamp++;
+				}
+				emitted[t] = 1;
+			}
+
+			// next fanning vertex: the candidate that stays in the cache the
+			// longest while still having triangles left
+			int best = -1;
+			int bestPriority = -1;
+			for (unsigned int i = 0; i < candidates.size(); i++) {
+				unsigned int v = candidates[i];
+				if (liveTriangles[v] <= 0) continue;
+				int priority = 0;
+				if (timeStamp - cacheTime[v] + 2 * liveTriangles[v] <= (int)cacheSize)
+					priority = timeStamp - cacheTime[v];
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					best = (int)v;
+				}
+			}
+			if (best < 0) {
+				// dead end: back up through recently used vertices, then scan
+				while (!deadEnd.empty() && best < 0) {
+					unsigned int v = deadEnd.back();
+					deadEnd.pop_back();
+					if (liveTriangles[v] > 0) best = (int)v;
+				}
+				while (best < 0 && cursor < triangleNum * 3) {
+					unsigned int v = meshIndices[cursor++];
+					if (liveTriangles[v] > 0) best = (int)v;
+				}
+			}
+			fanning = best;
+		}
+	}
+	MeshData::indexStorage.swap(reordered);
+
+	// renumber vertices by first use
+	std::vector<int> remap(vertexCount, -1);
+	std::vector<MeshVertex> sorted;
+	sorted.reserve(vertexCount);
+	for (unsigned int i = 0; i < MeshData::indexStorage.size(); i++) {
+		unsigned int v = MeshData::indexStorage[i];
+		if (remap[v] < 0) {
+			remap[v] = (int)sorted.size();
+			sorted.push_back(MeshData::vertexStorage[v]);
+		}
+		MeshData::indexStorage[i] = (unsigned int)remap[v];
+	}
+	MeshData::vertexStorage.swap(sorted);
+}
@@ -1,4 +1,5 @@
 #include "model.h"
+#include "modelcache.h"
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -6,45 +7,37 @@
 
 #include <iostream>
 #include <iomanip>
-//ModelClass::ModelClass() {
-//	ModelClass::transforms.resize(1);
-//	ModelClass::positions.resize(1);
-//	ModelClass::directions.resize(1);
-//	ModelClass::ups.resize(1);
-//
-//	ModelClass::transforms[0] = glm::mat4(1.0f);
-//	ModelClass::positions[0] = glm::vec3(0.0f, 0.0f, 0.0f);
-//	ModelClass::directions[0] = glm::vec3(0.0f, 0.0f, 1.0f);
-//	ModelClass::ups[0] = glm::vec3(0.0f, 1.0f, 0.0f);
-//}
-//ModelClass::ModelClass(const char* fileName) {
-//	ModelClass::ModelClass();
-//	loadObjFile(fileName);
-//}
-ModelClass::ModelClass() {
-	ModelClass::transforms.resize(1);
-	ModelClass::positions.resize(1);
-	ModelClass::directions.resize(1);
-	ModelClass::ups.resize(1);
 
-	ModelClass::transforms[0] = glm::mat4(1.0f);
-	ModelClass::positions[0] = glm::vec3(0.0f, 0.0f, 0.0f);
-	ModelClass::directions[0] = glm::vec3(0.0f, 0.0f, 1.0f);
-	ModelClass::ups[0] = glm::vec3(0.0f, 1.0f, 0.0f);
+// shared by every model that has nothing to draw yet
+static std::shared_ptr<const MeshData> emptyMesh() {
+	static std::shared_ptr<const MeshData> empty = std::make_shared<MeshData>();
+	return empty;
 }
-ModelClass::ModelClass(const char* fileName) {
-	ModelClass::transforms.resize(1);
-	ModelClass::positions.resize(1);
-	ModelClass::directions.resize(1);
-	ModelClass::ups.resize(1);
 
-	ModelClass::transforms[0] = glm::mat4(1.0f);
-	ModelClass::positions[0] = glm::vec3(0.0f, 0.0f, 0.0f);
-	ModelClass::directions[0] = glm::vec3(0.0f, 0.0f, 1.0f);
-	ModelClass::ups[0] = glm::vec3(0.0f, 1.0f, 0.0f);
-	loadObjFile(fileName);
+MeshData::MeshData() {
+	MeshData::vertices = NULL;
+	MeshData::vertexNum = 0;
+	MeshData::indices = NULL;
+	MeshData::indexNum = 0;
+	MeshData::boundsMin = glm::vec3(0.0f);
+	MeshData::boundsMax = glm::vec3(0.0f);
 }
-int ModelClass::loadObjFile(const char* fileName) {
+
+int MeshData::loadObjFile(const char* fileName) {
+	if (loadMeshFile(fileName) == 0) {
+		std::cout << "loading compiled model " << fileName << std::endl;
+		return 0;
+	}
+	if (parseObjFile(fileName) != 0) return -1;
+	if (writeMeshFile(fileName) != 0)
+		std::cout << "can't write compiled model for " << fileName << std::endl;
+	return 0;
+}
+
+// parse the OBJ text and de-index it: every face corner becomes one
+// interleaved vertex so the whole model draws from a single index buffer.
+// corners with the same position and normal are welded back together after
+int MeshData::parseObjFile(const char* fileName) {
 	tinyobj::ObjReader reader;
 	if (!reader.ParseFromFile(fileName)) return -1;
 
@@ -52,90 +45,165 @@ int ModelClass::loadObjFile(const char* fileName) {
 	const tinyobj::attrib_t & attrib = reader.GetAttrib();
 	const std::vector<tinyobj::shape_t> & shapes = reader.GetShapes();
 
-	//for (unsigned int meshIdx = 0; meshIdx < shapes.size(); meshIdx++){
-	//	const tinyobj::mesh_t &curMesh = shapes[meshIdx].mesh;
-	//	Mesh newMesh;
-	//	newMesh.color = glm::u8vec3(192, 192, 192);
-
-	//	for (int vertexIdx = 0; vertexIdx < attrib.vertices.size(); vertexIdx+=3){
-	//		
-	//		glm::vec3 newVertex(attrib.vertices[vertexIdx+0],
-	//			attrib.vertices[vertexIdx+1],
-	//			attrib.vertices[vertexIdx+2]);
-
-	//		ModelClass::verticesPos.push_back(newVertex);
-	//	}
-	//	for (int j = 0; j < curMesh.indices.size(); j ++) {
-	//		newMesh.indices.push_back((unsigned int)(curMesh.indices[j].vertex_index));
-	//	}
-
-
-	//	ModelClass::meshes.push_back(newMesh);
-	//}
-
-	ModelClass::verticesPos.clear();
-	for (int vertexIdx = 0; vertexIdx < attrib.vertices.size(); vertexIdx += 3) {
-		glm::vec3 newVertex(attrib.vertices[vertexIdx + 0],
-			attrib.vertices[vertexIdx + 1],
-			attrib.vertices[vertexIdx + 2]);
-
-		ModelClass::verticesPos.push_back(newVertex);
-	}
-
-	ModelClass::normals.clear();
-	for (int normalIdx = 0; normalIdx < attrib.normals.size(); normalIdx += 3) {
-		glm::vec3 newNormal(attrib.normals[normalIdx + 0],
-			attrib.normals[normalIdx + 1],
-			attrib.normals[normalIdx + 2]);
+	std::cout << "loading model " << fileName << std::endl;
+	size_t cornerNum = 0;
+	for (unsigned int meshIdx = 0; meshIdx < shapes.size(); meshIdx++)
+		cornerNum += shapes[meshIdx].mesh.indices.size();
 
-		ModelClass::normals.push_back(newNormal);
-	}
+	MeshData::vertexStorage.clear();
+	MeshData::indexStorage.clear();
+	MeshData::meshes.clear();
+	MeshData::vertexStorage.reserve(cornerNum);
+	MeshData::indexStorage.reserve(cornerNum);
+	MeshData::meshes.reserve(shapes.size());
 
-	ModelClass::meshes.clear();
-	std::cout << "loading model " << fileName << std::endl;
 	for (unsigned int meshIdx = 0; meshIdx < shapes.size(); meshIdx++){
 		const tinyobj::mesh_t &curMesh = shapes[meshIdx].mesh;
 		Mesh newMesh;
-		newMesh.color = glm::u8vec3(192, 192, 192);
+		newMesh.firstIndex = (unsigned int)MeshData::indexStorage.size();
+		newMesh.indexNum = (unsigned int)curMesh.indices.size();
+
+		for (unsigned int j = 0; j < curMesh.indices.size(); j ++) {
+			const tinyobj::index_t& corner = curMesh.indices[j];
+			MeshVertex newVertex;
+			newVertex.position = glm::vec3(attrib.vertices[3 * corner.vertex_index + 0],
+				attrib.vertices[3 * corner.vertex_index + 1],
+				attrib.vertices[3 * corner.vertex_index + 2]);
+			if (corner.normal_index >= 0) {
+				newVertex.normal = glm::normalize(glm::vec3(attrib.normals[3 * corner.normal_index + 0],
+					attrib.normals[3 * corner.normal_index + 1],
+					attrib.normals[3 * corner.normal_index + 2]));
+			}
+			else {
+				newVertex.normal = glm::vec3(0.0f);
+			}
+			MeshData::indexStorage.push_back((unsigned int)MeshData::vertexStorage.size());
+			MeshData::vertexStorage.push_back(newVertex);
+		}
 
-		for (int j = 0; j < curMesh.indices.size(); j ++) {
-			newMesh.posIndices.push_back((unsigned int)(curMesh.indices[j].vertex_index));
-			newMesh.normalIndices.push_back((unsigned int)(curMesh.indices[j].normal_index));
+		// files without normals get flat face normals
+		for (unsigned int j = 0; j + 2 < curMesh.indices.size(); j += 3) {
+			MeshVertex* face = &MeshData::vertexStorage[MeshData::indexStorage[newMesh.firstIndex + j]];
+			if (curMesh.indices[j].normal_index >= 0) continue;
+			glm::vec3 faceNormal = glm::cross(face[1].position - face[0].position, face[2].position - face[0].position);
+			if (glm::length(faceNormal) > 0.0f) faceNormal = glm::normalize(faceNormal);
+			face[0].normal = face[1].normal = face[2].normal = faceNormal;
 		}
-		//std::cout << newMesh.normalIndices.size() <<" , "<< newMesh.posIndices.size() << std::endl;
-		ModelClass::meshes.push_back(newMesh);
+		MeshData::meshes.push_back(newMesh);
 	}
-	
 
+	weldVertices();
+	optimizeVertexCache();
+	useStorage();
+	computeBounds();
 	return 0;
 }
-int ModelClass::loadVertices(std::vector <glm::vec3>& positions, std::vector <glm::vec3>& normals) {
-	ModelClass::verticesPos = std::vector<glm::vec3>(positions.begin(), positions.end());
-	ModelClass::normals = std::vector<glm::vec3>(normals.begin(), normals.end());
+int MeshData::loadVertices(std::vector <glm::vec3>& positions, std::vector <glm::vec3>& normals) {
+	MeshData::vertexStorage.resize(positions.size());
+	for (unsigned int i = 0; i < positions.size(); i++) {
+		MeshData::vertexStorage[i].position = positions[i];
+		MeshData::vertexStorage[i].normal = glm::normalize(normals[i]);
+	}
+
+	MeshData::indexStorage.resize(positions.size());
+	for (unsigned int i = 0; i < positions.size(); i++)
+		MeshData::indexStorage[i] = i;
 
-	ModelClass::meshes.clear();
+	MeshData::meshes.clear();
 	Mesh newMesh;
-	newMesh.posIndices.resize(ModelClass::verticesPos.size());
-	for (unsigned int i = 0; i < ModelClass::verticesPos.size(); i++)
-		newMesh.posIndices[i] = i;
+	newMesh.firstIndex = 0;
+	newMesh.indexNum = (unsigned int)MeshData::indexStorage.size();
+	MeshData::meshes.push_back(newMesh);
+
+	useStorage();
+	computeBounds();
+	return 0;
+}
+void MeshData::useStorage() {
+	MeshData::mapping.close();
+	MeshData::vertices = MeshData::vertexStorage.empty() ? NULL : &MeshData::vertexStorage[0];
+	MeshData::vertexNum = (unsigned int)MeshData::vertexStorage.size();
+	MeshData::indices = MeshData::indexStorage.empty() ? NULL : &MeshData::indexStorage[0];
+	MeshData::indexNum = (unsigned int)MeshData::indexStorage.size();
+}
+void MeshData::computeBounds() {
+	if (MeshData::vertexNum == 0) {
+		MeshData::boundsMin = MeshData::boundsMax = glm::vec3(0.0f);
+		return;
+	}
+	MeshData::boundsMin = MeshData::boundsMax = MeshData::vertices[0].position;
+	for (unsigned int i = 1; i < MeshData::vertexNum; i++) {
+		MeshData::boundsMin = glm::min(MeshData::boundsMin, MeshData::vertices[i].position);
+		MeshData::boundsMax = glm::max(MeshData::boundsMax, MeshData::vertices[i].position);
+	}
+}
 
-	newMesh.normalIndices.resize(ModelClass::normals.size());
-	for (unsigned int i = 0; i < ModelClass::normals.size(); i++)
-		newMesh.normalIndices[i] = i;
-	ModelClass::meshes.push_back(newMesh);
 
+ModelClass::ModelClass() {
+	ModelClass::baseColor = glm::u8vec3(192, 192, 192);
+	initTransforms();
+	setMesh(emptyMesh());
+}
+ModelClass::ModelClass(const char* fileName) {
+	ModelClass::baseColor = glm::u8vec3(192, 192, 192);
+	initTransforms();
+	setMesh(emptyMesh());
+	loadObjFile(fileName);
+}
+ModelClass::ModelClass(std::shared_ptr<const MeshData> meshData) {
+	ModelClass::baseColor = glm::u8vec3(192, 192, 192);
+	initTransforms();
+	setMesh(meshData);
+}
+ModelClass::~ModelClass() {
+	ModelCache::global().forget(this);
+}
+void ModelClass::initTransforms() {
+	ModelClass::transforms.resize(1);
+	ModelClass::positions.resize(1);
+	ModelClass::directions.resize(1);
+	ModelClass::ups.resize(1);
+
+	ModelClass::transforms[0] = glm::mat4(1.0f);
+	ModelClass::positions[0] = glm::vec3(0.0f, 0.0f, 0.0f);
+	ModelClass::directions[0] = glm::vec3(0.0f, 0.0f, 1.0f);
+	ModelClass::ups[0] = glm::vec3(0.0f, 1.0f, 0.0f);
+}
+// models loaded from files go through the cache so each file is parsed once
+int ModelClass::loadObjFile(const char* fileName) {
+	std::shared_ptr<const MeshData> loaded = ModelCache::global().get(fileName);
+	if (!loaded) return -1;
+	setMesh(loaded);
 	return 0;
 }
+void ModelClass::loadObjFileAsync(const char* fileName) {
+	ModelCache::global().getAsync(this, fileName);
+}
+// generated geometry (like the track) is owned by this model alone
+int ModelClass::loadVertices(std::vector <glm::vec3>& positions, std::vector <glm::vec3>& normals) {
+	std::shared_ptr<MeshData> newMesh = std::make_shared<MeshData>();
+	newMesh->loadVertices(positions, normals);
+	setMesh(newMesh);
+	return 0;
+}
+void ModelClass::setMesh(std::shared_ptr<const MeshData> meshData) {
+	ModelClass::mesh = meshData ? meshData : emptyMesh();
+	ModelClass::colors.resize(ModelClass::mesh->meshes.size(), ModelClass::baseColor);
+}
+void ModelClass::clearVertices() {
+	setMesh(emptyMesh());
+}
 
 
 void ModelClass::setColor(glm::u8vec3 color, int idx) {
 	if (idx < 0) {
-		for (unsigned int meshIdx = 0; meshIdx < ModelClass::meshes.size(); meshIdx++) {
-			ModelClass::meshes[meshIdx].color = color;
+		ModelClass::baseColor = color;
+		for (unsigned int meshIdx = 0; meshIdx < ModelClass::colors.size(); meshIdx++) {
+			ModelClass::colors[meshIdx] = color;
 		}
 	}
-	else {
-		ModelClass::meshes[idx % ModelClass::meshes.size()].color = color;
+	else if (!ModelClass::colors.empty()) {
+		ModelClass::colors[idx % ModelClass::colors.size()] = color;
 	}
 }
 void ModelClass::setColor(unsigned char r, unsigned char g, unsigned char b, int idx) {
@@ -150,58 +218,28 @@ void ModelClass::draw(bool doingShadows, GLenum glBeginMode) {
 
 
 void ModelClass::drawOne(unsigned int idx, bool doingShadows, GLenum glBeginMode) {
-	//for (unsigned int meshIdx = 0; meshIdx < ModelClass::meshes.size(); meshIdx++) {
-	//	Mesh& currMesh = ModelClass::meshes[meshIdx];
-	//	glBegin(GL_TRIANGLES);
-	//	if (!doingShadows)
-	//		glColor3ub(currMesh.color.x, currMesh.color.y, currMesh.color.z);
-	//	for (unsigned int i = 0; i < currMesh.posIndices.size(); i++) {
-	//		unsigned int index;
-
-	//		index = currMesh.normalIndices[i];
-	//		glm::vec3 drawNormal = ModelClass::transforms[idx] * glm::vec4(ModelClass::normals[index], 0.0f);
-	//		drawNormal = glm::normalize(drawNormal);
-	//		//glm::vec3 drawNormal = ModelClass::normals[index];
-	//		//std::cout << std::setprecision(2) << drawNormal.x << "\t" << drawNormal.y << "\t" << drawNormal.z << "\n";
-	//		glNormal3f(drawNormal.x, drawNormal.y, drawNormal.z);
-
-	//		index = currMesh.posIndices[i];
-	//		glm::vec3 drawPos = ModelClass::transforms[idx] * glm::vec4(ModelClass::verticesPos[index], 1.0f);
-	//		glVertex3f(drawPos.x, drawPos.y, drawPos.z);
-	//	}
-	//	glEnd();
-	//}
-
-
-	for (unsigned int meshIdx = 0; meshIdx < ModelClass::meshes.size(); meshIdx++) {
-		Mesh& currMesh = ModelClass::meshes[meshIdx];
-
-		glMatrixMode(GL_MODELVIEW);
-		glPushMatrix();
-		glMultMatrixf(glm::value_ptr(ModelClass::transforms[idx]));
-		//glLoadIdentity();
-
-		glBegin(glBeginMode);
-		for (unsigned int i = 0; i < currMesh.posIndices.size(); i++) {
-			unsigned int index;
-
-			index = currMesh.normalIndices[i];
-			glm::vec3 drawNormal = ModelClass::normals[index];
-			drawNormal = glm::normalize(drawNormal);
-			//glm::vec3 drawNormal = ModelClass::normals[index];
-			//std::cout << std::setprecision(2) << drawNormal.x << "\t" << drawNormal.y << "\t" << drawNormal.z << "\n";
-
-			index = currMesh.posIndices[i];
-			glm::vec3 drawPos = ModelClass::verticesPos[index];
-			//glm::vec3 drawPos = ModelClass::transforms[idx] * glm::vec4(ModelClass::verticesPos[index], 1.0f);
-			if (!doingShadows)
-				glColor3ub(currMesh.color.x, currMesh.color.y, currMesh.color.z);
-			glNormal3f(drawNormal.x, drawNormal.y, drawNormal.z);
-			glVertex3f(drawPos.x, drawPos.y, drawPos.z);
-		}
-		glEnd();
-		glPopMatrix();
+	const MeshData& meshData = *ModelClass::mesh;
+	if (meshData.indexNum == 0) return;
+
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glMultMatrixf(glm::value_ptr(ModelClass::transforms[idx]));
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(MeshVertex), &meshData.vertices[0].position);
+	glNormalPointer(GL_FLOAT, sizeof(MeshVertex), &meshData.vertices[0].normal);
+	for (unsigned int meshIdx = 0; meshIdx < meshData.meshes.size(); meshIdx++) {
+		const Mesh& currMesh = meshData.meshes[meshIdx];
+		const glm::u8vec3& color = ModelClass::colors[meshIdx];
+		if (!doingShadows)
+			glColor3ub(color.x, color.y, color.z);
+		glDrawElements(glBeginMode, currMesh.indexNum, GL_UNSIGNED_INT, meshData.indices + currMesh.firstIndex);
 	}
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	glPopMatrix();
 }
 
 void ModelClass::setInstanceNum(unsigned int num) {
@@ -212,4 +250,4 @@ void ModelClass::setInstanceNum(unsigned int num) {
 }
 unsigned int ModelClass::getInstanceNum(unsigned int num) {
 	return transforms.size();
-}
\ No newline at end of file
+}
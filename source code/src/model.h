@@ -7,17 +7,74 @@
 #include <glm/gtc/type_ptr.hpp>
 #include<glm/gtx/transform.hpp>
 #include <vector>
+#include <stdio.h>
+#include <memory>
 #include <tiny_obj_loader.h>
+#include "mappedfile.h"
+
+// interleaved vertex, laid out for glVertexPointer/glNormalPointer
+typedef struct {
+	glm::vec3 position;
+	glm::vec3 normal;
+}MeshVertex;
+
+// a range of the shared index buffer drawn with one color
 typedef struct {
-	glm::u8vec3 color;
-	std::vector <unsigned int> posIndices;
-	std::vector <unsigned int> normalIndices;
+	unsigned int firstIndex;
+	unsigned int indexNum;
 }Mesh;
-class ModelClass {
+
+// geometry of a model. once built it is never modified, so one MeshData
+// can be shared by every ModelClass that draws the same file.
+// vertices and indices either live in this object or point into a
+// memory mapped binary mesh file (see meshfile.cpp)
+class MeshData {
 public:
 	std::vector <Mesh> meshes;
-	std::vector <glm::vec3> verticesPos;
-	std::vector <glm::vec3> normals;
+	const MeshVertex* vertices;
+	unsigned int vertexNum;
+	const unsigned int* indices;
+	unsigned int indexNum;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+public:
+	MeshData();
+	// loads the compiled binary next to the file if it is up to date,
+	// otherwise parses the OBJ text and writes the binary for next time
+	int loadObjFile(const char*);
+	int parseObjFile(const char*);
+	int loadVertices(std::vector <glm::vec3>& positions, std::vector <glm::vec3>& normals);
+
+	// binary mesh files, implemented in meshfile.cpp
+	int loadMeshFile(const char* objFileName);
+	int writeMeshFile(const char* objFileName) const;
+	// the same layout inside a bigger file (a track bundle): written at the
+	// current position of fp, mapped again from offset. size is what was written
+	int writeMeshSection(FILE* fp, size_t& size) const;
+	int loadMeshSection(const char* fileName, size_t offset);
+private:
+	MeshData(const MeshData&);
+	MeshData& operator=(const MeshData&);
+	void useStorage();
+	// point into the mesh at offset of the mapping, its header checked
+	void useMapping(size_t offset);
+	void computeBounds();
+	// load time optimization, implemented in meshoptimize.cpp
+	void weldVertices();
+	void optimizeVertexCache(unsigned int cacheSize = 16);
+private:
+	std::vector <MeshVertex> vertexStorage;
+	std::vector <unsigned int> indexStorage;
+	MappedFile mapping;
+};
+
+// one drawable use of a mesh: the shared geometry plus the state that
+// belongs to this use only (colors and instance transforms)
+class ModelClass {
+public:
+	std::shared_ptr<const MeshData> mesh;
+	std::vector <glm::u8vec3> colors;
+	glm::u8vec3 baseColor;
 public:
 	std::vector<glm::mat4> transforms;
 	std::vector<glm::vec3> positions;
@@ -26,8 +83,13 @@ public:
 public:
 	ModelClass();
 	ModelClass(const char*);
+	ModelClass(std::shared_ptr<const MeshData> meshData);
+	~ModelClass();
 	int loadObjFile(const char*);
+	// returns at once, the mesh shows up after ModelCache::publish()
+	void loadObjFileAsync(const char*);
 	int loadVertices(std::vector <glm::vec3>& positions, std::vector <glm::vec3>& normals);
+	void setMesh(std::shared_ptr<const MeshData> meshData);
 	void clearVertices();
 	void setColor(glm::u8vec3, int idx = -1);
 	void setColor(unsigned char, unsigned char, unsigned char, int idx = -1);
@@ -38,4 +100,6 @@ public:
 
 	void draw(bool doingShadows = false, GLenum glBeginMode = GL_TRIANGLES);
 	void drawOne(unsigned int idx, bool doingShadows = false, GLenum glBeginMode = GL_TRIANGLES);
+private:
+	void initTransforms();
 };
@@ -0,0 +1,174 @@
+#include "modelcache.h"
+
+#include <iostream>
+
+ModelCache& ModelCache::global() {
+	static ModelCache cache;
+	return cache;
+}
+
+ModelCache::ModelCache() {
+	ModelCache::stopping = false;
+	ModelCache::readyCallback = NULL;
+	ModelCache::readyData = NULL;
+}
+
+ModelCache::~ModelCache() {
+	ModelCache::stop();
+}
+
+std::shared_ptr<const MeshData> ModelCache::get(const char* fileName) {
+	std::string key(fileName);
+	std::map<std::string, std::weak_ptr<const MeshData> >::iterator found = ModelCache::models.find(key);
+	if (found != ModelCache::models.end()) {
+		std::shared_ptr<const MeshData> shared = found->second.lock();
+		if (shared) return shared;
+	}
+
+	std::shared_ptr<MeshData> newMesh = std::make_shared<MeshData>();
+	if (newMesh->loadObjFile(fileName) != 0) {
+		std::cout << "failed to load model " << fileName << std::endl;
+		return std::shared_ptr<const MeshData>();
+	}
+	ModelCache::models[key] = newMesh;
+	return newMesh;
+}
+
+void ModelCache::getAsync(ModelClass* model, const char* fileName) {
+	std::string key(fileName);
+	std::map<std::string, std::weak_ptr<const MeshData> >::iterator found = ModelCache::models.find(key);
+	if (found != ModelCache::models.end()) {
+		std::shared_ptr<const MeshData> shared = found->second.lock();
+		if (shared) {
+			model->setMesh(shared);
+			return;
+		}
+	}
+
+	// somebody already asked for this file, just wait with them
+	std::vector<ModelClass*>& waitingModels = ModelCache::waiting[key];
+	waitingModels.push_back(model);
+	if (waitingModels.size() > 1) return;
+
+	startWorkers();
+	{
+		std::lock_guard<std::mutex> guard(ModelCache::lock);
+		ModelCache::jobs.push_back(key);
+	}
+	ModelCache::jobReady.notify_one();
+}
+
+unsigned int ModelCache::publish() {
+	std::vector<std::pair<std::string, std::shared_ptr<MeshData> > > done;
+	{
+		std::lock_guard<std::mutex> guard(ModelCache::lock);
+		done.swap(ModelCache::finished);
+	}
+
+	unsigned int changed = 0;
+	for (unsigned int i = 0; i < done.size(); i++) {
+		const std::string& key = done[i].first;
+		std::vector<ModelClass*> waitingModels;
+		waitingModels.swap(ModelCache::waiting[key]);
+		ModelCache::waiting.erase(key);
+		if (!done[i].second) {
+			std::cout << "failed to load model " << key << std::endl;
+			continue;
+		}
+		ModelCache::models[key] = done[i].second;
+		for (unsigned int j = 0; j < waitingModels.size(); j++) {
+			waitingModels[j]->setMesh(done[i].second);
+			changed++;
+		}
+	}
+	return changed;
+}
+
+bool ModelCache::loading() {
+	return !ModelCache::waiting.empty();
+}
+
+void ModelCache::forget(ModelClass* model) {
+	std::map<std::string, std::vector<ModelClass*> >::iterator it;
+	for (it = ModelCache::waiting.begin(); it != ModelCache::waiting.end(); ++it) {
+		std::vector<ModelClass*>& waitingModels = it->second;
+		for (unsigned int i = 0; i < waitingModels.size(); i++) {
+			if (waitingModels[i] == model) {
+				waitingModels.erase(waitingModels.begin() + i);
+				i--;
+			}
+		}
+	}
+}
+
+void ModelCache::setReadyCallback(void (*callback)(void*), void* data) {
+	std::lock_guard<std::mutex> guard(ModelCache::lock);
+	ModelCache::readyCallback = callback;
+	ModelCache::readyData = data;
+}
+
+void ModelCache::stop() {
+	{
+		std::lock_guard<std::mutex> guard(ModelCache::lock);
+		ModelCache::stopping = true;
+		ModelCache::readyCallback = NULL;
+		ModelCache::readyData = NULL;
+	}
+	ModelCache::jobReady.notify_all();
+	for (unsigned int i = 0; i < ModelCache::workers.size(); i++)
+		ModelCache::workers[i].join();
+	ModelCache::workers.clear();
+
+	// nobody publishes these any more, a later request loads them again
+	ModelCache::jobs.clear();
+	ModelCache::finished.clear();
+	ModelCache::waiting.clear();
+	ModelCache::stopping = false;
+}
+
+void ModelCache::startWorkers() {
+	if (!ModelCache::workers.empty()) return;
+	unsigned int workerNum = std::thread::hardware_concurrency();
+	if (workerNum < 1) workerNum = 1;
+	if (workerNum > 4) workerNum = 4;
+	for (unsigned int i = 0; i < workerNum; i++)
+		ModelCache::workers.push_back(std::thread(&ModelCache::workerLoop, this));
+}
+
+void ModelCache::workerLoop() {
+	while (1) {
+		std::string fileName;
+		{
+			std::unique_lock<std::mutex> guard(ModelCache::lock);
+			while (!ModelCache::stopping && ModelCache::jobs.empty())
+				ModelCache::jobReady.wait(guard);
+			if (ModelCache::stopping) return;
+			fileName = ModelCache::jobs.front();
+			ModelCache::jobs.pop_front();
+		}
+
+		std::shared_ptr<MeshData> newMesh = std::make_shared<MeshData>();
+		if (newMesh->loadObjFile(fileName.c_str()) != 0)
+			newMesh.reset();
+
+		std::lock_guard<std::mutex> guard(ModelCache::lock);
+		ModelCache::finished.push_back(std::make_pair(fileName, newMesh));
+		if (ModelCache::readyCallback != NULL)
+			ModelCache::readyCallback(ModelCache::readyData);
+	}
+}
+
+void ModelCache::purge() {
+	std::map<std::string, std::weak_ptr<const MeshData> >::iterator it = ModelCache::models.begin();
+	while (it != ModelCache::models.end()) {
+		if (it->second.expired()) it = ModelCache::models.erase(it);
+		else ++it;
+	}
+}
+
+unsigned int ModelCache::loadedNum() {
+	unsigned int num = 0;
+	for (std::map<std::string, std::weak_ptr<const MeshData> >::iterator it = ModelCache::models.begin(); it != ModelCache::models.end(); ++it)
+		if (!it->second.expired()) num++;
+	return num;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "model.h"
+
+#include <map>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Interns loaded models by file path. Every ModelClass asking for the same
+// file gets the same read-only MeshData; the data is reference counted by the
+// shared_ptrs handed out and released when the last user goes away.
+//
+// Files can also be loaded on a small worker pool with getAsync(). The model
+// keeps drawing its placeholder (empty) mesh until publish() is called on the
+// UI thread after the worker has finished.
+class ModelCache {
+public:
+	static ModelCache& global();
+	~ModelCache();
+public:
+	// returns NULL if the file can't be loaded
+	std::shared_ptr<const MeshData> get(const char* fileName);
+	// queue the file on the worker pool and give it to the model once published
+	void getAsync(ModelClass* model, const char* fileName);
+	// hand finished meshes to the models waiting for them (UI thread only),
+	// returns the number of models that changed
+	unsigned int publish();
+	// true while files are queued, loading or waiting to be published
+	bool loading();
+	// drop a model that is going away from the waiting lists
+	void forget(ModelClass* model);
+	// called on a worker thread every time a file finished loading, with the
+	// cache locked: once it is reset no worker calls the old one any more
+	void setReadyCallback(void (*callback)(void*), void* data);
+	// join the workers and drop the files still loading (UI thread only),
+	// the next getAsync() starts them again
+	void stop();
+	// forget entries whose mesh is no longer used by anyone
+	void purge();
+	unsigned int loadedNum();
+private:
+	ModelCache();
+	void startWorkers();
+	void workerLoop();
+private:
+	std::map<std::string, std::weak_ptr<const MeshData> > models;
+	std::map<std::string, std::vector<ModelClass*> > waiting;
+
+	// shared with the workers, guarded by lock
+	std::mutex lock;
+	std::condition_variable jobReady;
+	std::deque<std::string> jobs;
+	std::vector<std::pair<std::string, std::shared_ptr<MeshData> > > finished;
+	bool stopping;
+	void (*readyCallback)(void*);
+	void* readyData;
+
+	std::vector<std::thread> workers;
+};
@@ -0,0 +1,144 @@
+#include "particle.h"
+
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define PARTICLE_USE_SSE
+#endif
+
+ParticleSystem::ParticleSystem(unsigned int maxParticles) {
+	// keep the pool a multiple of 4 so the SSE loop never needs a tail
+	ParticleSystem::capacity = (maxParticles + 3) & ~3u;
+	ParticleSystem::posX.resize(capacity);
+	ParticleSystem::posY.resize(capacity);
+	ParticleSystem::posZ.resize(capacity);
+	ParticleSystem::velX.resize(capacity);
+	ParticleSystem::velY.resize(capacity);
+	ParticleSystem::velZ.resize(capacity);
+	ParticleSystem::age.resize(capacity);
+	ParticleSystem::size.resize(capacity);
+	ParticleSystem::quadVertices.resize(capacity * 4);
+
+	ParticleSystem::lifeTime = 2.4f;
+	ParticleSystem::growRate = 1.2f;
+	ParticleSystem::buoyancy = 3.0f;
+	ParticleSystem::drag = 1.5f;
+	ParticleSystem::color = glm::u8vec3(32, 32, 32);
+	ParticleSystem::seed = 12345u;
+	clear();
+}
+
+void ParticleSystem::clear() {
+	for (unsigned int i = 0; i < capacity; i++) {
+		posX[i] = posY[i] = posZ[i] = 0.0f;
+		velX[i] = velY[i] = velZ[i] = 0.0f;
+		size[i] = 0.0f;
+		age[i] = lifeTime;	// start dead
+	}
+	ParticleSystem::head = 0;
+	ParticleSystem::emitRemainder = 0.0f;
+}
+
+void ParticleSystem::emit(const glm::vec3& position, const glm::vec3& velocity, float startSize) {
+	posX[head] = position.x;
+	posY[head] = position.y;
+	posZ[head] = position.z;
+	velX[head] = velocity.x;
+	velY[head] = velocity.y;
+	velZ[head] = velocity.z;
+	age[head] = 0.0f;
+	size[head] = startSize;
+	head = (head + 1) % capacity;
+}
+
+// emit "rate" particles per second of simulation time, carrying the fraction
+// left over to the next call so low rates still emit evenly
+void ParticleSystem::emitOverTime(float deltaTime, float rate, const glm::vec3& position, const glm::vec3& velocity, float startSize, float spread) {
+	if (deltaTime <= 0.0f || rate <= 0.0f) return;
+	emitRemainder += deltaTime * rate;
+	while (emitRemainder >= 1.0f) {
+		emitRemainder -= 1.0f;
+		glm::vec3 jitter(random(), random(), random());
+		emit(position, velocity + jitter * spread, startSize);
+	}
+}
+
+void ParticleSystem::update(float deltaTime) {
+	if (deltaTime <= 0.0f) return;
+	const float damping = expf(-drag * deltaTime);
+	const float lift = buoyancy * deltaTime;
+	const float grow = growRate * deltaTime;
+
+	unsigned int i = 0;
+#ifdef PARTICLE_USE_SSE
+	const __m128 dt4 = _mm_set1_ps(deltaTime);
+	const __m128 damping4 = _mm_set1_ps(damping);
+	const __m128 lift4 = _mm_set1_ps(lift);
+	const __m128 grow4 = _mm_set1_ps(grow);
+	for (; i + 4 <= capacity; i += 4) {
+		__m128 vx = _mm_mul_ps(_mm_loadu_ps(&velX[i]), damping4);
+		__m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&velY[i]), damping4), lift4);
+		__m128 vz = _mm_mul_ps(_mm_loadu_ps(&velZ[i]), damping4);
+		_mm_storeu_ps(&velX[i], vx);
+		_mm_storeu_ps(&velY[i], vy);
+		_mm_storeu_ps(&velZ[i], vz);
+		_mm_storeu_ps(&posX[i], _mm_add_ps(_mm_loadu_ps(&posX[i]), _mm_mul_ps(vx, dt4)));
+		_mm_storeu_ps(&posY[i], _mm_add_ps(_mm_loadu_ps(&posY[i]), _mm_mul_ps(vy, dt4)));
+		_mm_storeu_ps(&posZ[i], _mm_add_ps(_mm_loadu_ps(&posZ[i]), _mm_mul_ps(vz, dt4)));
+		_mm_storeu_ps(&age[i], _mm_add_ps(_mm_loadu_ps(&age[i]), dt4));
+		_mm_storeu_ps(&size[i], _mm_add_ps(_mm_loadu_ps(&size[i]), grow4));
+	}
+#endif
+	for (; i < capacity; i++) {
+		velX[i] = velX[i] * damping;
+		velY[i] = velY[i] * damping + lift;
+		velZ[i] = velZ[i] * damping;
+		posX[i] += velX[i] * deltaTime;
+		posY[i] += velY[i] * deltaTime;
+		posZ[i] += velZ[i] * deltaTime;
+		age[i] += deltaTime;
+		size[i] += grow;
+	}
+}
+
+unsigned int ParticleSystem::aliveNum() {
+	unsigned int num = 0;
+	for (unsigned int i = 0; i < capacity; i++)
+		if (age[i] < lifeTime) num++;
+	return num;
+}
+
+void ParticleSystem::draw(const glm::vec3& cameraRight, const glm::vec3& cameraUp, bool doingShadows) {
+	unsigned int vertexNum = 0;
+	for (unsigned int i = 0; i < capacity; i++) {
+		if (age[i] >= lifeTime) continue;
+		// shrink away over the end of the particle's life
+		float life = age[i] / lifeTime;
+		float halfSize = 0.5f * size[i] * (1.0f - life * life);
+		glm::vec3 center(posX[i], posY[i], posZ[i]);
+		glm::vec3 right = cameraRight * halfSize;
+		glm::vec3 up = cameraUp * halfSize;
+		quadVertices[vertexNum++] = center - right - up;
+		quadVertices[vertexNum++] = center + right - up;
+		quadVertices[vertexNum++] = center + right + up;
+		quadVertices[vertexNum++] = center - right + up;
+	}
+	if (vertexNum == 0) return;
+
+	glm::vec3 normal = glm::cross(cameraRight, cameraUp);
+	if (!doingShadows)
+		glColor3ub(color.x, color.y, color.z);
+	glNormal3f(normal.x, normal.y, normal.z);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, &quadVertices[0]);
+	glDrawArrays(GL_QUADS, 0, vertexNum);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+// cheap deterministic noise in [-1, 1] for emission jitter
+float ParticleSystem::random() {
+	seed = seed * 1664525u + 1013904223u;
+	return (float)(seed >> 8) / (float)(1 << 23) - 1.0f;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "GL/glu.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Fixed size particle pool for effects like the locomotive smoke.
+// Particles live in a ring buffer stored as separate arrays (structure of
+// arrays) so update() can advance four of them per SSE instruction.
+// New particles overwrite the oldest slot, so memory never grows.
+class ParticleSystem {
+public:
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> velX, velY, velZ;
+	std::vector<float> age;
+	std::vector<float> size;
+public:
+	float lifeTime;		// seconds until a particle disappears
+	float growRate;		// size gained per second
+	float buoyancy;		// upward acceleration
+	float drag;			// velocity damping per second
+	glm::u8vec3 color;
+private:
+	unsigned int capacity;
+	unsigned int head;
+	float emitRemainder;
+	unsigned int seed;
+	std::vector<glm::vec3> quadVertices;
+public:
+	ParticleSystem(unsigned int maxParticles = 256);
+	void clear();
+	void emit(const glm::vec3& position, const glm::vec3& velocity, float startSize);
+	void emitOverTime(float deltaTime, float rate, const glm::vec3& position, const glm::vec3& velocity, float startSize, float spread = 0.0f);
+	void update(float deltaTime);
+	unsigned int aliveNum();
+	// draw every live particle as a camera facing quad in one glDrawArrays call
+	void draw(const glm::vec3& cameraRight, const glm::vec3& cameraUp, bool doingShadows = false);
+private:
+	float random();
+};
@@ -0,0 +1,189 @@
+#include "picking.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+Picker::Picker() {
+	for (int kind = 0; kind < KIND_NUM; kind++) {
+		layers[kind].revision = 0;
+		layers[kind].filled = false;
+		layers[kind].built = false;
+	}
+}
+
+bool Picker::begin(Kind kind, unsigned long revision) {
+	Layer& layer = layers[kind];
+	if (layer.filled && layer.revision == revision) return false;
+	layer.items.clear();
+	layer.itemMin.clear();
+	layer.itemMax.clear();
+	layer.revision = revision;
+	layer.filled = true;
+	layer.built = false;
+	return true;
+}
+
+void Picker::add(Kind kind, unsigned int index, const glm::mat4& transform, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+	Layer& layer = layers[kind];
+	Item item;
+	item.toLocal = glm::inverse(transform);
+	item.boxMin = boxMin;
+	item.boxMax = boxMax;
+	item.index = index;
+	layer.items.push_back(item);
+
+	// world bounds of the eight corners
+	glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 local((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 4) ? boxMax.z : boxMin.z);
+		glm::vec3 world = transform * glm::vec4(local, 1.0f);
+		lo = glm::min(lo, world);
+		hi = glm::max(hi, world);
+	}
+	layer.itemMin.push_back(lo);
+	layer.itemMax.push_back(hi);
+}
+
+void Picker::build(Layer& layer) {
+	layer.nodes.clear();
+	unsigned int itemNum = (unsigned int)layer.items.size();
+	layer.order.resize(itemNum);
+	layer.itemCenter.resize(itemNum);
+	for (unsigned int i = 0; i < itemNum; i++) {
+		layer.order[i] = i;
+		layer.itemCenter[i] = 0.5f * (layer.itemMin[i] + layer.itemMax[i]);
+	}
+	if (itemNum > 0) {
+		layer.nodes.reserve(2 * itemNum);
+		layer.nodes.push_back(Node());
+		buildNode(layer, 0, 0, itemNum);
+	}
+	layer.itemCenter.clear();
+	layer.built = true;
+}
+
+// split at the median along the longest side of the centers' bounds
+void Picker::buildNode(Layer& layer, unsigned int nodeIdx, unsigned int first, unsigned int count) {
+	glm::vec3 lo(FLT_MAX), hi(-FLT_MAX), centerLo(FLT_MAX), centerHi(-FLT_MAX);
+	for (unsigned int i = first; i < first + count; i++) {
+		unsigned int item = layer.order[i];
+		lo = glm::min(lo, layer.itemMin[item]);
+		hi = glm::max(hi, layer.itemMax[item]);
+		centerLo = glm::min(centerLo, layer.itemCenter[item]);
+		centerHi = glm::max(centerHi, layer.itemCenter[item]);
+	}
+	layer.nodes[nodeIdx].boundsMin = lo;
+	layer.nodes[nodeIdx].boundsMax = hi;
+
+	if (count <= 4) {
+		layer.nodes[nodeIdx].first = first;
+		layer.nodes[nodeIdx].count = count;
+		return;
+	}
+
+	glm::vec3 extent = centerHi - centerLo;
+	int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+	unsigned int half = count / 2;
+	std::vector<unsigned int>::iterator begin = layer.order.begin() + first;
+	const glm::vec3* centers = &layer.itemCenter[0];
+	std::nth_element(begin, begin + half, begin + count, [centers, axis](unsigned int a, unsigned int b) {
+		return centers[a][axis] < centers[b][axis];
+	});
+
+	// the children go next to each other, the right one right after the left
+	unsigned int left = (unsigned int)layer.nodes.size();
+	layer.nodes.push_back(Node());
+	layer.nodes.push_back(Node());
+	layer.nodes[nodeIdx].first = left;
+	layer.nodes[nodeIdx].count = 0;
+	buildNode(layer, left, first, half);
+	buildNode(layer, left + 1, first + half, count - half);
+}
+
+bool Picker::cast(const glm::vec3& origin, const glm::vec3& direction, PickHit& hit, unsigned int kinds) {
+	float nearest = FLT_MAX;
+	bool found = false;
+	for (int kind = 0; kind < KIND_NUM; kind++) {
+		if ((kinds & (1 << kind)) == 0) continue;
+		unsigned int index;
+		if (castLayer(layers[kind], origin, direction, nearest, index)) {
+			hit.kind = kind;
+			hit.index = index;
+			found = true;
+		}
+	}
+	if (found) {
+		hit.distance = nearest;
+		hit.point = origin + direction * nearest;
+	}
+	return found;
+}
+
+// nearest first through the hierarchy, skipping nodes that start past the
+// best hit so far. nearest comes in as the best of the other kinds
+bool Picker::castLayer(Layer& layer, const glm::vec3& origin, const glm::vec3& direction, float& nearest, unsigned int& index) {
+	if (!layer.built) build(layer);
+	if (layer.nodes.empty()) return false;
+
+	glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	bool found = false;
+	float t;
+	stack.clear();
+	if (rayBox(origin, inverseDirection, layer.nodes[0].boundsMin, layer.nodes[0].boundsMax, nearest, t))
+		stack.push_back(0);
+	while (!stack.empty()) {
+		const Node& node = layer.nodes[stack.back()];
+		stack.pop_back();
+		if (node.count > 0) {
+			for (unsigned int i = node.first; i < node.first + node.count; i++) {
+				// the exact test, in the box's own frame
+				const Item& item = layer.items[layer.order[i]];
+				glm::vec3 localOrigin = item.toLocal * glm::vec4(origin, 1.0f);
+				glm::vec3 localDirection = item.toLocal * glm::vec4(direction, 0.0f);
+				glm::vec3 localInverse(1.0f / localDirection.x, 1.0f / localDirection.y, 1.0f / localDirection.z);
+				if (rayBox(localOrigin, localInverse, item.boxMin, item.boxMax, nearest, t)) {
+					nearest = t;
+					index = item.index;
+					found = true;
+				}
+			}
+			continue;
+		}
+		// push the farther child first so the nearer one is tried first
+		float leftT, rightT;
+		bool leftHit = rayBox(origin, inverseDirection, layer.nodes[node.first].boundsMin, layer.nodes[node.first].boundsMax, nearest, leftT);
+		bool rightHit = rayBox(origin, inverseDirection, layer.nodes[node.first + 1].boundsMin, layer.nodes[node.first + 1].boundsMax, nearest, rightT);
+		if (leftHit && rightHit) {
+			bool leftFirst = leftT <= rightT;
+			stack.push_back(leftFirst ? node.first + 1 : node.first);
+			stack.push_back(leftFirst ? node.first : node.first + 1);
+		}
+		else if (leftHit)
+			stack.push_back(node.first);
+		else if (rightHit)
+			stack.push_back(node.first + 1);
+	}
+	return found;
+}
+
+// slabs; a ray starting inside the box enters it at 0
+bool Picker::rayBox(const glm::vec3& origin, const glm::vec3& inverseDirection,
+	const glm::vec3& boxMin, const glm::vec3& boxMax, float maxT, float& t) {
+	float enter = 0.0f, leave = maxT;
+	for (int axis = 0; axis < 3; axis++) {
+		float t0 = (boxMin[axis] - origin[axis]) * inverseDirection[axis];
+		float t1 = (boxMax[axis] - origin[axis]) * inverseDirection[axis];
+		if (t0 > t1) std::swap(t0, t1);
+		// a ray along the slab gives nan, which only counts when it's outside
+		if (t0 != t0 || t1 != t1) {
+			if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis]) return false;
+			continue;
+		}
+		enter = fmaxf(enter, t0);
+		leave = fminf(leave, t1);
+		if (enter > leave) return false;
+	}
+	t = enter;
+	return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// what a pick ray hit, the nearest one along it
+struct PickHit {
+	int kind;				// a Picker::Kind
+	unsigned int index;		// control point, track sample, car or tree number
+	float distance;			// along the ray, in lengths of its direction
+	glm::vec3 point;
+};
+
+// Ray casting on the CPU for the mouse, instead of drawing the scene again
+// in GL_SELECT mode. Every pickable thing is a box in its own frame
+// (control point cubes, track segments, the train, cars and trees). Each
+// kind keeps its boxes in a bounding volume hierarchy of their world
+// bounds, so a cast only tests the few boxes near the ray; the hierarchy
+// is rebuilt on the next cast after the kind was refilled.
+class Picker {
+public:
+	enum Kind { CONTROL_POINT, TRACK, TRAIN, CAR, TREE, KIND_NUM };
+	enum { ALL = (1 << KIND_NUM) - 1 };
+public:
+	Picker();
+	// returns false when the kind is up to date with revision. otherwise
+	// empties it and returns true, add() its boxes then
+	bool begin(Kind kind, unsigned long revision);
+	// a box from boxMin to boxMax in the frame transform puts into the world
+	void add(Kind kind, unsigned int index, const glm::mat4& transform, const glm::vec3& boxMin, const glm::vec3& boxMax);
+	// the nearest box of the kinds in the mask (1 << kind) that the ray
+	// from origin along direction enters. false if none
+	bool cast(const glm::vec3& origin, const glm::vec3& direction, PickHit& hit, unsigned int kinds = ALL);
+private:
+	struct Item {
+		glm::mat4 toLocal;
+		glm::vec3 boxMin;
+		glm::vec3 boxMax;
+		unsigned int index;
+	};
+	struct Node {
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		unsigned int first;		// leaf: first item, inner: left child (right is next)
+		unsigned int count;		// items in a leaf, 0 for inner nodes
+	};
+	struct Layer {
+		std::vector<Item> items;
+		std::vector<glm::vec3> itemMin;		// world bounds
+		std::vector<glm::vec3> itemMax;
+		std::vector<glm::vec3> itemCenter;	// while building
+		std::vector<unsigned int> order;	// items as the leaves hold them
+		std::vector<Node> nodes;
+		unsigned long revision;
+		bool filled;
+		bool built;
+	};
+	void build(Layer& layer);
+	void buildNode(Layer& layer, unsigned int nodeIdx, unsigned int first, unsigned int count);
+	bool castLayer(Layer& layer, const glm::vec3& origin, const glm::vec3& direction, float& nearest, unsigned int& index);
+	// where the ray enters the box, false if it misses or enters past maxT
+	static bool rayBox(const glm::vec3& origin, const glm::vec3& inverseDirection,
+		const glm::vec3& boxMin, const glm::vec3& boxMax, float maxT, float& t);
+private:
+	Layer layers[KIND_NUM];
+	std::vector<unsigned int> stack;	// reused by cast
+};
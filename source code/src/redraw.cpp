@@ -0,0 +1,43 @@
+#include "redraw.h"
+
+#include <chrono>
+
+RedrawScheduler::RedrawScheduler(Fl_Gl_Window* window, double frameInterval) {
+	RedrawScheduler::window = window;
+	RedrawScheduler::frameInterval = frameInterval;
+	RedrawScheduler::pending = false;
+	RedrawScheduler::scheduled = false;
+	RedrawScheduler::lastFrameTime = 0.0;
+}
+
+RedrawScheduler::~RedrawScheduler() {
+	if (scheduled)
+		Fl::remove_timeout(frameCB, this);
+}
+
+void RedrawScheduler::invalidate() {
+	pending = true;
+	if (scheduled) return;
+
+	// wait for the next slot, right away if the last frame is long enough ago
+	double wait = lastFrameTime + frameInterval - now();
+	if (wait < 0.0) wait = 0.0;
+	Fl::add_timeout(wait, frameCB, this);
+	scheduled = true;
+}
+
+void RedrawScheduler::frameStarted() {
+	lastFrameTime = now();
+	pending = false;
+}
+
+void RedrawScheduler::frameCB(void* scheduler) {
+	RedrawScheduler* self = (RedrawScheduler*)scheduler;
+	self->scheduled = false;
+	if (self->pending)
+		self->window->damage(1);
+}
+
+double RedrawScheduler::now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
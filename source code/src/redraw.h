@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Fl/Fl.H>
+#include <Fl/Fl_Gl_Window.h>
+
+// Turns "something changed" notices from the widgets, the run timer and
+// the mouse into at most one redraw per display refresh. Several notices
+// within one refresh interval share a frame, and without any notice the
+// window is not drawn at all (except when the window system asks).
+// What a frame has to redo is up to the caches behind it (the revisions
+// of the track, the scene and the shadow map), so a notice only says
+// that something changed.
+class RedrawScheduler {
+public:
+	double frameInterval;	// seconds between frames, one refresh at 60Hz
+private:
+	Fl_Gl_Window* window;
+	bool pending;		// something changed since the last frame
+	bool scheduled;
+	double lastFrameTime;
+public:
+	RedrawScheduler(Fl_Gl_Window* window, double frameInterval = 1.0 / 60.0);
+	~RedrawScheduler();
+	// note a change, the window is redrawn at the next frame slot
+	void invalidate();
+	// call at the start of draw(), this frame shows the pending changes
+	void frameStarted();
+private:
+	static void frameCB(void* scheduler);
+	static double now();
+};
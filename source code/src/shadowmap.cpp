@@ -0,0 +1,178 @@
+#include "shadowmap.h"
+
+#include <math.h>
+#include <fstream>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+ShadowMap::ShadowMap(unsigned int resolution, float sceneRadius) {
+	ShadowMap::resolution = resolution;
+	ShadowMap::sceneRadius = sceneRadius;
+	ShadowMap::shader = NULL;
+	ShadowMap::frameBuffer = 0;
+	ShadowMap::depthTexture = 0;
+	ShadowMap::created = false;
+	ShadowMap::usable = false;
+	ShadowMap::active = false;
+	ShadowMap::mapValid = false;
+	ShadowMap::mapSunDir = glm::vec3(0.0f);
+	ShadowMap::mapRevision = 0;
+	ShadowMap::lightViewProj = glm::mat4(1.0f);
+}
+
+ShadowMap::~ShadowMap() {
+	delete shader;
+}
+
+bool ShadowMap::init(const char* vertexFile, const char* fragmentFile) {
+	created = true;
+	usable = false;
+
+	// the Shader class exits on a missing file, fall back to stencil shadows instead
+	if (!std::ifstream(vertexFile).good() || !std::ifstream(fragmentFile).good()) {
+		std::cout << "shadow map shaders not found, using stencil shadows" << std::endl;
+		return false;
+	}
+	if (!GLAD_GL_VERSION_3_0) {
+		std::cout << "no framebuffer object support, using stencil shadows" << std::endl;
+		return false;
+	}
+
+	glGenTextures(1, &depthTexture);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, resolution, resolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	// linear filtering on a compare texture gives 2x2 pcf for one lookup
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	// outside the map counts as lit
+	GLfloat border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &frameBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "shadow map framebuffer incomplete (0x" << std::hex << status << std::dec << "), using stencil shadows" << std::endl;
+		glDeleteFramebuffers(1, &frameBuffer);
+		glDeleteTextures(1, &depthTexture);
+		frameBuffer = 0;
+		depthTexture = 0;
+		return false;
+	}
+
+	shader = new Shader(vertexFile, fragmentFile);
+	usable = true;
+	mapValid = false;
+	return true;
+}
+
+bool ShadowMap::isCreated() {
+	return created;
+}
+
+bool ShadowMap::isUsable() {
+	return usable;
+}
+
+bool ShadowMap::needsUpdate(const glm::vec3& sunDirection, unsigned long sceneRevision) {
+	return !mapValid || sceneRevision != mapRevision || sunDirection != mapSunDir;
+}
+
+void ShadowMap::beginDepthPass(const glm::vec3& sunDirection, unsigned long sceneRevision) {
+	// an orthographic box around the floor, looking down the sun direction
+	glm::vec3 sunDir = glm::normalize(sunDirection);
+	glm::vec3 up = (fabsf(sunDir.y) > 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 lightView = glm::lookAt(sunDir * (2.0f * sceneRadius), glm::vec3(0.0f), up);
+	glm::mat4 lightProj = glm::ortho(-sceneRadius, sceneRadius, -sceneRadius, sceneRadius, 1.0f, 4.0f * sceneRadius);
+	lightViewProj = lightProj * lightView;
+	mapSunDir = sunDirection;
+	mapRevision = sceneRevision;
+
+	glGetIntegerv(GL_VIEWPORT, savedViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+	glViewport(0, 0, resolution, resolution);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_STENCIL_TEST);
+	// push the casters back a little so lit surfaces don't shadow themselves
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadMatrixf(glm::value_ptr(lightProj));
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadMatrixf(glm::value_ptr(lightView));
+}
+
+void ShadowMap::endDepthPass() {
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glEnable(GL_LIGHTING);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+	mapValid = true;
+}
+
+void ShadowMap::beginLitPass(const glm::mat4& cameraModelview, bool sunShadows) {
+	// eye space -> world -> sun clip space -> [0, 1] texture space
+	glm::mat4 bias(
+		0.5f, 0.0f, 0.0f, 0.0f,
+		0.0f, 0.5f, 0.0f, 0.0f,
+		0.0f, 0.0f, 0.5f, 0.0f,
+		0.5f, 0.5f, 0.5f, 1.0f
+	);
+	glm::mat4 eyeToShadow = bias * lightViewProj * glm::inverse(cameraModelview);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	shader->Activate();
+	shader->setUniform("shadowMap", 1);
+	shader->setUniform("eyeToShadow", eyeToShadow);
+	shader->setUniform("useShadow", sunShadows && mapValid);
+	// glEnable(GL_LIGHTi) isn't visible to glsl, pass it along
+	shader->setUniform("lightOn[0]", glIsEnabled(GL_LIGHT0) == GL_TRUE);
+	shader->setUniform("lightOn[1]", glIsEnabled(GL_LIGHT1) == GL_TRUE);
+	shader->setUniform("lightOn[2]", glIsEnabled(GL_LIGHT2) == GL_TRUE);
+	shader->setUniform("lightOn[3]", glIsEnabled(GL_LIGHT3) == GL_TRUE);
+	shader->setUniform("lighting", glIsEnabled(GL_LIGHTING) == GL_TRUE);
+	active = true;
+}
+
+void ShadowMap::endLitPass() {
+	glUseProgram(0);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	active = false;
+}
+
+void ShadowMap::setLighting(bool enabled) {
+	if (enabled) glEnable(GL_LIGHTING);
+	else glDisable(GL_LIGHTING);
+	if (active)
+		shader->setUniform("lighting", enabled);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include "ShaderClass.h"
+
+// Sun shadows from a depth texture, an alternative to squashing the whole
+// scene onto the floor a second time every frame.
+// The depth map is rendered from the sun into a framebuffer object and kept
+// while the sun and the scene stay the same, so a still scene (or a moving
+// camera) costs a single lit pass. The lit pass runs a shader that redoes
+// the fixed function lights per pixel and darkens what the sun can't see.
+class ShadowMap {
+public:
+	unsigned int resolution;	// depth texture size in texels
+	float sceneRadius;			// half size of the box the sun looks at
+private:
+	Shader* shader;
+	GLuint frameBuffer;
+	GLuint depthTexture;
+	bool created;		// init() has been tried
+	bool usable;		// shaders compiled and the framebuffer is complete
+	bool active;		// between beginLitPass() and endLitPass()
+	bool mapValid;		// depth map matches mapSunDir / mapRevision
+	glm::vec3 mapSunDir;
+	unsigned long mapRevision;
+	glm::mat4 lightViewProj;
+	GLint savedViewport[4];
+public:
+	ShadowMap(unsigned int resolution = 2048, float sceneRadius = 160.0f);
+	// the GL objects go away with the context of the window owning them
+	~ShadowMap();
+	// create the depth texture, framebuffer and shader, needs a current context.
+	// returns false (and stays unusable) when the files or extensions are missing
+	bool init(const char* vertexFile, const char* fragmentFile);
+	bool isCreated();
+	bool isUsable();
+	// true when the depth map is out of date for this sun and scene revision
+	bool needsUpdate(const glm::vec3& sunDirection, unsigned long sceneRevision);
+	// render target and matrices for drawing the shadow casters from the sun
+	void beginDepthPass(const glm::vec3& sunDirection, unsigned long sceneRevision);
+	void endDepthPass();
+	// bind the shader and depth map for the normal pass. cameraModelview is
+	// the modelview matrix the lights were set up with
+	void beginLitPass(const glm::mat4& cameraModelview, bool sunShadows);
+	void endLitPass();
+	// glEnable / glDisable(GL_LIGHTING) that the lit pass shader also follows
+	void setLighting(bool enabled);
+private:
+	ShadowMap(const ShadowMap&);
+	ShadowMap& operator=(const ShadowMap&);
+};
@@ -0,0 +1,251 @@
+#include "simulation.h"
+
+#include <chrono>
+#include <math.h>
+
+#include "TrainView.H"
+#include "allocationcheck.h"
+
+void InstancePoses::copyFrom(const ModelClass& model) {
+	InstancePoses::transforms = model.transforms;
+	InstancePoses::positions = model.positions;
+	InstancePoses::directions = model.directions;
+	InstancePoses::ups = model.ups;
+}
+
+void InstancePoses::copyTo(ModelClass& model) const {
+	model.transforms = InstancePoses::transforms;
+	model.positions = InstancePoses::positions;
+	model.directions = InstancePoses::directions;
+	model.ups = InstancePoses::ups;
+}
+
+Simulation::Simulation() {
+	Simulation::running = false;
+	Simulation::speed = 0.0f;
+	Simulation::arcLength = false;
+	Simulation::physics = false;
+	Simulation::smoke = false;
+	Simulation::tickInterval = 1.0 / 40.0;
+
+	Simulation::trainPose = new ModelClass();
+	Simulation::carPose = new ModelClass();
+	Simulation::carPose->setInstanceNum(0);
+	Simulation::trainControl = new CaronTrack(trainPose);
+	Simulation::smokeParticles.color = glm::u8vec3(32, 32, 32);
+	Simulation::prevSpeed = 0.0f;
+	Simulation::tick = 0;
+
+	Simulation::trackPending = false;
+	Simulation::newCarsNum = 0;
+	Simulation::carsPending = false;
+	Simulation::resetPending = false;
+	Simulation::moveDistance = 0.0f;
+	Simulation::movePending = false;
+
+	Simulation::stopping = false;
+	Simulation::readyCallback = NULL;
+	Simulation::readyData = NULL;
+}
+
+Simulation::~Simulation() {
+	stop();
+	for (unsigned int carControlIdx = 0; carControlIdx < carControl.size(); carControlIdx++)
+		delete carControl[carControlIdx];
+	delete trainControl;
+	delete trainPose;
+	delete carPose;
+}
+
+void Simulation::start() {
+	if (thread.joinable()) return;
+	stopping = false;
+	thread = std::thread(&Simulation::threadLoop, this);
+}
+
+void Simulation::stop() {
+	if (!thread.joinable()) return;
+	stopping = true;
+	thread.join();
+}
+
+bool Simulation::isStarted() {
+	return thread.joinable();
+}
+
+void Simulation::setReadyCallback(void (*callback)(void*), void* data) {
+	readyCallback = callback;
+	readyData = data;
+}
+
+void Simulation::setTrack(std::shared_ptr<const TrackData> track) {
+	std::atomic_store(&newTrack, track);
+	trackPending = true;
+}
+
+void Simulation::setCars(unsigned int num) {
+	newCarsNum = num;
+	carsPending = true;
+}
+
+void Simulation::reset() {
+	resetPending = true;
+}
+
+void Simulation::move(float distance) {
+	float old = moveDistance.load();
+	while (!moveDistance.compare_exchange_weak(old, old + distance)) {}
+	movePending = true;
+}
+
+void Simulation::step(float deltaTime) {
+	if (isStarted()) return;
+	applyRequests();
+	if (deltaTime > 0.0f) advance(deltaTime);
+	publish();
+}
+
+bool Simulation::acquire() {
+	return snapshots.acquire();
+}
+
+SceneSnapshot& Simulation::snapshot() {
+	return snapshots.readSlot();
+}
+
+// the same steps the UI used to do directly: new track, number of cars,
+// back to the start, then move
+bool Simulation::applyRequests() {
+	bool changed = false;
+	if (trackPending.exchange(false)) {
+		track = std::atomic_load(&newTrack);
+		trainControl->UpdateTruckParameter(track.get());
+		for (unsigned int carControlIdx = 0; carControlIdx < carControl.size(); carControlIdx++)
+			carControl[carControlIdx]->UpdateTruckParameter(track.get());
+		changed = true;
+	}
+	if (carsPending.exchange(false)) {
+		unsigned int num = newCarsNum;
+		carPose->setInstanceNum(num);
+		while (carControl.size() < num) {
+			CaronTrack* newControl = new CaronTrack(carPose);
+			newControl->UpdateTruckParameter(track.get());
+			newControl->Move(trainControl->GetProcess() - 11 * carControl.size() - 13);
+			carControl.push_back(newControl);
+		}
+		while (carControl.size() > num) {
+			delete carControl.back();
+			carControl.pop_back();
+		}
+		changed = true;
+	}
+	if (resetPending.exchange(false)) {
+		trainControl->ResetProcess();
+		for (unsigned int carControlIdx = 0; carControlIdx < carControl.size(); carControlIdx++) {
+			carControl[carControlIdx]->ResetProcess();
+			carControl[carControlIdx]->SetProcess(0.0f);
+			carControl[carControlIdx]->Move(trainControl->GetProcess() - 11 * carControlIdx - 13);
+		}
+		changed = true;
+	}
+	if (movePending.exchange(false)) {
+		moveTrain(moveDistance.exchange(0.0f));
+		changed = true;
+	}
+	return changed;
+}
+
+// one tick of a running train, what TrainWindow::advanceTrain used to do.
+// it runs on fixed buffers only, debug builds check it never allocates
+void Simulation::advance(float deltaTime) {
+	AllocationCheck tickCheck("Simulation::advance");
+	if (arcLength) {
+		float targetSpeed = speed / 30.0f;
+		float nowSpeed = targetSpeed;
+		if (physics) {
+			float slop = glm::normalize(trainPose->directions[0]).y;
+			float force = targetSpeed * 10.0f;
+			float gravity = 0.98f;
+			float mass = 40.0f;
+			float drag = prevSpeed * 10.0f;
+			// the load on the wheels in g: 1 on the flat, more through a
+			// valley and less over a crest. speeds are per tick, so the
+			// turn's pull v^2 * curvature is in the same units over deltaTime
+			glm::vec3 up = trainPose->ups[0];
+			float pull = prevSpeed * prevSpeed * glm::dot(trainControl->GetCurvature(), up) / deltaTime;
+			float load = fmaxf(up.y + pull / gravity, 0.0f);
+			// steel wheels on steel rails, and the brakes
+			float resistance = 0.001f * gravity * mass * load;
+			if (speed == 0.0f) {
+				force = 0.0f;
+				resistance += 2.0f;
+			}
+			float totalForce = force - gravity * mass * slop - drag;
+
+			float acc = totalForce / mass;
+			nowSpeed = prevSpeed + acc * deltaTime;
+			// the resistance works against the motion: it can stop the train
+			// within a tick but never push it back, so it comes to rest
+			// instead of rocking around zero speed
+			float slowdown = resistance / mass * deltaTime;
+			if (fabsf(nowSpeed) <= slowdown) nowSpeed = 0.0f;
+			else nowSpeed -= copysignf(slowdown, nowSpeed);
+		}
+		moveTrain(nowSpeed);
+		prevSpeed = nowSpeed;
+	}
+	else if (track && !track->empty()) {
+		float moveLength = glm::length(track->direct(trainControl->GetIndex()));
+		moveTrain(moveLength * speed * deltaTime);
+	}
+
+	smokeParticles.update(deltaTime);
+	if (smoke) {
+		// puffs per second follow the speed, counted on the simulation clock
+		glm::mat4& trainTransform = trainPose->transforms[0];
+		glm::vec3 chimneyPos = trainTransform * glm::vec4(0.0f, 75.0f, 30.0f, 1.0f);
+		glm::vec3 puffVelocity = 4.0f * trainPose->ups[0];
+		float puffRate = 2.0f + speed;
+		smokeParticles.emitOverTime(deltaTime, puffRate, chimneyPos, puffVelocity, 1.5f, 0.8f);
+	}
+	tickCheck.verify();
+}
+
+void Simulation::moveTrain(float distance) {
+	trainControl->Move(distance, 0);
+	for (unsigned int carControlIdx = 0; carControlIdx < carControl.size(); carControlIdx++)
+		carControl[carControlIdx]->Move(distance, carControlIdx);
+}
+
+void Simulation::publish() {
+	SceneSnapshot& next = snapshots.writeSlot();
+	next.train.copyFrom(*trainPose);
+	next.cars.copyFrom(*carPose);
+	next.smoke = smokeParticles;
+	next.tick = ++tick;
+	snapshots.publish();
+	if (readyCallback != NULL) readyCallback(readyData);
+}
+
+void Simulation::threadLoop() {
+	typedef std::chrono::steady_clock Clock;
+	Clock::duration interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(tickInterval));
+	Clock::time_point last = Clock::now();
+	Clock::time_point next = last;
+	while (!stopping) {
+		next += interval;
+		std::this_thread::sleep_until(next);
+		Clock::time_point now = Clock::now();
+		// after a long stall don't try to catch up tick by tick
+		if (now - next > 4 * interval) next = now;
+		float deltaTime = std::chrono::duration<float>(now - last).count();
+		last = now;
+
+		bool changed = applyRequests();
+		if (running) {
+			advance(deltaTime);
+			changed = true;
+		}
+		if (changed) publish();
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "model.h"
+#include "particle.h"
+#include "trackbuilder.h"
+#include "triplebuffer.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class CaronTrack;
+
+// the instance arrays of one model as CaronTrack leaves them
+struct InstancePoses {
+	std::vector<glm::mat4> transforms;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> directions;
+	std::vector<glm::vec3> ups;
+	void copyFrom(const ModelClass& model);
+	void copyTo(ModelClass& model) const;
+};
+
+// everything the renderer takes from one simulation tick
+struct SceneSnapshot {
+	InstancePoses train;
+	InstancePoses cars;
+	ParticleSystem smoke;
+	unsigned long tick;
+};
+
+// Moves the train, its cars and the smoke on a thread of its own, at its own
+// rate no matter how long frames take to draw. After every tick that changed
+// something the poses are copied into a SceneSnapshot and handed to the
+// renderer through a TripleBuffer, then the ready callback is called (from
+// the simulation thread).
+// The UI thread talks to it only through atomics: the widget values below,
+// and requests (track, cars, reset, move) picked up at the start of a tick
+// in that order. The track itself is shared read-only as a TrackData.
+class Simulation {
+public:
+	// widget state, written by the UI thread and read once per tick
+	std::atomic<bool> running;
+	std::atomic<float> speed;
+	std::atomic<bool> arcLength;
+	std::atomic<bool> physics;
+	std::atomic<bool> smoke;
+	double tickInterval;						// seconds, 40 ticks a second
+private:
+	// owned by the simulation thread (or step() while there is none)
+	ModelClass* trainPose;
+	ModelClass* carPose;
+	CaronTrack* trainControl;
+	std::vector<CaronTrack*> carControl;
+	std::shared_ptr<const TrackData> track;
+	ParticleSystem smokeParticles;
+	float prevSpeed;
+	unsigned long tick;
+
+	// requests from the UI thread
+	std::shared_ptr<const TrackData> newTrack;	// std::atomic_load / atomic_store
+	std::atomic<bool> trackPending;
+	std::atomic<unsigned int> newCarsNum;
+	std::atomic<bool> carsPending;
+	std::atomic<bool> resetPending;
+	std::atomic<float> moveDistance;
+	std::atomic<bool> movePending;
+
+	TripleBuffer<SceneSnapshot> snapshots;
+	std::atomic<bool> stopping;
+	std::thread thread;
+	void (*readyCallback)(void*);
+	void* readyData;
+public:
+	Simulation();
+	~Simulation();
+	// run the ticks on the simulation thread until stop()
+	void start();
+	void stop();
+	bool isStarted();
+	// called on the simulation thread after a snapshot was published,
+	// set it before start()
+	void setReadyCallback(void (*callback)(void*), void* data);
+
+	// requests, any thread
+	void setTrack(std::shared_ptr<const TrackData> track);
+	void setCars(unsigned int num);
+	void reset();
+	void move(float distance);
+
+	// one tick on the calling thread, only while the thread isn't started
+	void step(float deltaTime);
+
+	// renderer side: take the newest snapshot, false if there is nothing new.
+	// snapshot() stays valid until the next acquire()
+	bool acquire();
+	SceneSnapshot& snapshot();
+private:
+	bool applyRequests();
+	void advance(float deltaTime);
+	void moveTrain(float distance);
+	void publish();
+	void threadLoop();
+private:
+	Simulation(const Simulation&);
+	Simulation& operator=(const Simulation&);
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <stddef.h>
+
+// the curves the track can follow, in the order of the spline browser
+enum SplineType {
+	SPLINE_LINEAR,
+	SPLINE_CARDINAL,
+	SPLINE_BSPLINE,
+};
+
+// the basis of a cubic segment through four points: point k weighs
+// w[0][k] t^3 + w[1][k] t^2 + w[2][k] t + w[3][k] at t
+struct SplineBasis {
+	float w[4][4];
+
+	bool operator==(const SplineBasis& other) const {
+		for (int i = 0; i < 4; i++)
+			for (int k = 0; k < 4; k++)
+				if (w[i][k] != other.w[i][k]) return false;
+		return true;
+	}
+	bool operator!=(const SplineBasis& other) const { return !(*this == other); }
+};
+
+// what the derivatives say about the curve at a sample
+struct SplineShape {
+	glm::vec3 tangent;		// unit
+	glm::vec3 curvature;	// toward the middle of the turn, 1/radius long
+	float torsion;			// how fast it twists out of its plane, per unit of length
+};
+
+constexpr SplineBasis cardinalBasis(float tension) {
+	float s = (1.0f - tension) / 2.0f;
+	return SplineBasis{ {
+		{ -s, 2 - s, s - 2, s },
+		{ 2 * s, s - 3, 3 - 2 * s, -s },
+		{ -s, 0, s, 0 },
+		{ 0, 1, 0, 0 } } };
+}
+
+constexpr SplineBasis bsplineBasis = { {
+	{ -1 / 6.0f, 3 / 6.0f, -3 / 6.0f, 1 / 6.0f },
+	{ 3 / 6.0f, -6 / 6.0f, 3 / 6.0f, 0 },
+	{ -3 / 6.0f, 0, 3 / 6.0f, 0 },
+	{ 1 / 6.0f, 4 / 6.0f, 1 / 6.0f, 0 } } };
+
+// the shape of the curve from its first three derivatives. where the
+// first one vanishes (a cardinal spline of tension 1 stops at its points)
+// the tangent is where the curve goes on to, and it doesn't bend there
+inline SplineShape splineShape(const glm::vec3& d1, const glm::vec3& d2, const glm::vec3& d3) {
+	SplineShape shape;
+	shape.curvature = glm::vec3(0.0f);
+	shape.torsion = 0.0f;
+	float speed = glm::length(d1);
+	if (speed <= 0.0f) {
+		glm::vec3 ahead = (glm::length(d2) > 0.0f) ? d2 : d3;
+		shape.tangent = (glm::length(ahead) > 0.0f) ? glm::normalize(ahead) : glm::vec3(0.0f);
+		return shape;
+	}
+	shape.tangent = d1 / speed;
+	glm::vec3 binormal = glm::cross(d1, d2);
+	float binormal2 = glm::dot(binormal, binormal);
+	float speed2 = speed * speed;
+	shape.curvature = glm::cross(binormal, d1) / (speed2 * speed2);
+	// a straight stretch has no plane to twist out of
+	if (binormal2 > 1e-8f * speed2 * speed2 * speed2)
+		shape.torsion = glm::dot(binormal, d3) / binormal2;
+	return shape;
+}
+
+// The samples of one segment, for a spline type fixed at compile time so
+// each type gets its own loop. Linear is a lerp from p1 to p2. A cubic is
+// turned into the coefficients of its polynomial once per segment, then
+// every sample is three multiply-adds, and its derivatives three more.
+// The B-spline uses its constant basis, the cardinal spline the one its
+// tension gave. shapes may be NULL when only the samples are wanted.
+template <int Type>
+struct SplineKernel {
+	static void segment(const SplineBasis& basis, const glm::vec3& p0, const glm::vec3& p1,
+		const glm::vec3& p2, const glm::vec3& p3, unsigned int divideLine, glm::vec3* samples,
+		SplineShape* shapes = NULL) {
+		float step = 1.0f / divideLine;
+		float t = 0.0f;
+		if constexpr (Type == SPLINE_LINEAR) {
+			glm::vec3 direct = p2 - p1;
+			for (unsigned int j = 0; j < divideLine; j++) {
+				samples[j] = p1 + t * direct;
+				t += step;
+			}
+			if (shapes != NULL) {
+				SplineShape shape = splineShape(direct, glm::vec3(0.0f), glm::vec3(0.0f));
+				for (unsigned int j = 0; j < divideLine; j++)
+					shapes[j] = shape;
+			}
+		}
+		else {
+			const SplineBasis& b = (Type == SPLINE_BSPLINE) ? bsplineBasis : basis;
+			glm::vec3 c[4];
+			for (int i = 0; i < 4; i++)
+				c[i] = b.w[i][0] * p0 + b.w[i][1] * p1 + b.w[i][2] * p2 + b.w[i][3] * p3;
+			if (shapes == NULL) {
+				for (unsigned int j = 0; j < divideLine; j++) {
+					samples[j] = ((c[0] * t + c[1]) * t + c[2]) * t + c[3];
+					t += step;
+				}
+				return;
+			}
+			glm::vec3 d3 = 6.0f * c[0];
+			for (unsigned int j = 0; j < divideLine; j++) {
+				samples[j] = ((c[0] * t + c[1]) * t + c[2]) * t + c[3];
+				glm::vec3 d1 = (3.0f * c[0] * t + 2.0f * c[1]) * t + c[2];
+				glm::vec3 d2 = d3 * t + 2.0f * c[1];
+				shapes[j] = splineShape(d1, d2, d3);
+				t += step;
+			}
+		}
+	}
+};
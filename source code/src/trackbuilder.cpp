@@ -0,0 +1,512 @@
+#include "trackbuilder.h"
+#include "trackplacement.h"
+
+#include <glm/gtx/transform.hpp>
+#include <algorithm>
+#include <math.h>
+
+TrackBuilder::TrackBuilder() {
+	TrackBuilder::latest = 0;
+	TrackBuilder::hasJob = false;
+	TrackBuilder::building = false;
+	TrackBuilder::jobGeneration = 0;
+	TrackBuilder::readyValid = false;
+	TrackBuilder::stopping = false;
+	TrackBuilder::readyCallback = NULL;
+	TrackBuilder::readyData = NULL;
+}
+
+TrackBuilder::~TrackBuilder() {
+	{
+		std::lock_guard<std::mutex> guard(TrackBuilder::lock);
+		TrackBuilder::stopping = true;
+		TrackBuilder::readyCallback = NULL;
+	}
+	// let a running build give up at its next check
+	TrackBuilder::latest++;
+	TrackBuilder::jobReady.notify_all();
+	if (TrackBuilder::worker.joinable())
+		TrackBuilder::worker.join();
+}
+
+unsigned long TrackBuilder::request(const TrackBuildInput& input) {
+	unsigned long generation;
+	{
+		std::lock_guard<std::mutex> guard(TrackBuilder::lock);
+		generation = ++TrackBuilder::latest;
+		// an older job nobody started yet is simply replaced
+		TrackBuilder::job = input;
+		TrackBuilder::jobGeneration = generation;
+		TrackBuilder::hasJob = true;
+		if (!TrackBuilder::worker.joinable())
+			TrackBuilder::worker = std::thread(&TrackBuilder::workerLoop, this);
+	}
+	TrackBuilder::jobReady.notify_one();
+	return generation;
+}
+
+void TrackBuilder::cancel() {
+	std::lock_guard<std::mutex> guard(TrackBuilder::lock);
+	TrackBuilder::latest++;
+	TrackBuilder::hasJob = false;
+	TrackBuilder::readyValid = false;
+}
+
+bool TrackBuilder::takeResult(TrackBuildResult& result) {
+	std::lock_guard<std::mutex> guard(TrackBuilder::lock);
+	if (!TrackBuilder::readyValid) return false;
+	std::swap(TrackBuilder::ready, result);
+	TrackBuilder::readyValid = false;
+	return true;
+}
+
+bool TrackBuilder::busy() {
+	std::lock_guard<std::mutex> guard(TrackBuilder::lock);
+	return TrackBuilder::hasJob || TrackBuilder::building;
+}
+
+void TrackBuilder::setReadyCallback(void (*callback)(void*), void* data) {
+	std::lock_guard<std::mutex> guard(TrackBuilder::lock);
+	TrackBuilder::readyCallback = callback;
+	TrackBuilder::readyData = data;
+}
+
+void TrackBuilder::workerLoop() {
+	TrackBuildInput input;
+	while (1) {
+		unsigned long generation;
+		{
+			std::unique_lock<std::mutex> guard(TrackBuilder::lock);
+			TrackBuilder::building = false;
+			while (!TrackBuilder::stopping && !TrackBuilder::hasJob)
+				TrackBuilder::jobReady.wait(guard);
+			if (TrackBuilder::stopping) return;
+			std::swap(input, TrackBuilder::job);
+			generation = TrackBuilder::jobGeneration;
+			TrackBuilder::hasJob = false;
+			TrackBuilder::building = true;
+		}
+
+		if (!build(input, TrackBuilder::back, &(TrackBuilder::splineCache), &(TrackBuilder::latest), generation))
+			continue;
+
+		void (*callback)(void*);
+		void* data;
+		{
+			std::lock_guard<std::mutex> guard(TrackBuilder::lock);
+			// a request may have come in after the last check
+			if (generation != TrackBuilder::latest) continue;
+			std::swap(TrackBuilder::back, TrackBuilder::ready);
+			TrackBuilder::readyValid = true;
+			callback = TrackBuilder::readyCallback;
+			data = TrackBuilder::readyData;
+		}
+		if (callback != NULL) callback(data);
+	}
+}
+
+bool TrackBuilder::build(const TrackBuildInput& input, TrackBuildResult& result, TrackSplineCache* cache,
+	const std::atomic<unsigned long>* latest, unsigned long generation) {
+	// checked between the stages and every few thousand samples inside them
+	auto stale = [&]() { return latest != NULL && latest->load() != generation; };
+
+	unsigned int verticesNum = (unsigned int)input.positions.size();
+	if (verticesNum < 4) return false;
+
+	// kept in the result, so steady editing doesn't allocate them again
+	std::vector<glm::vec3>& trackDirect = result.controlDirects;
+	std::vector<glm::vec3>& trackCross = result.controlCrosses;
+	trackDirect.resize(verticesNum);
+	trackCross.resize(verticesNum);
+
+	for (unsigned int i = 0; i < verticesNum; i++)
+		trackDirect[i] = input.positions[(i + 1) % verticesNum] - input.positions[i];
+
+	for (unsigned int i = 0; i < verticesNum; i++) {
+		glm::vec3 cr0 = glm::cross(trackDirect[i], input.orients[i]);
+		glm::vec3 cr1 = glm::cross(trackDirect[(i + 1) % verticesNum], input.orients[(i + 1) % verticesNum]);
+		trackCross[(i + 1) % verticesNum] = glm::normalize(glm::normalize(cr0) + glm::normalize(cr1));
+	}
+
+	// calculate spline, the rails are derived from these two. without a
+	// cache every segment is evaluated
+	TrackSplineCache ownCache;
+	if (cache == NULL) cache = &ownCache;
+	// the last build's track goes with the samples the cache holds now, it
+	// is put back once this build is complete
+	std::shared_ptr<const TrackData> previous;
+	previous.swap(cache->track);
+	result.splineSegments = updateSpline(input, trackCross, *cache);
+	const std::vector<glm::vec3>& trackSplinePosOri = cache->splinePos;
+	const std::vector<glm::vec3>& trackSplineCrossOri = cache->splineCross;
+	const std::vector<SplineShape>& trackSplineShapeOri = cache->splineShape;
+	if (stale()) return false;
+
+	// Adaptive subdivision
+	std::vector<glm::vec3>& samplePositions = result.samplePositions;
+	std::vector<glm::vec3>& sampleCrosses = result.sampleCrosses;
+	std::vector<SplineShape>& sampleShapes = result.sampleShapes;
+	samplePositions.clear();
+	sampleCrosses.clear();
+	sampleShapes.clear();
+	if (input.adaptive) {
+		// a sample is kept when the chord skipping to the next one would
+		// stray 0.001 from the track. arc minus chord is about
+		// arc * turn^2 / 24, the turn summed from the tangents, which also
+		// counts the corners of a linear track
+		unsigned int splineNum = (unsigned int)trackSplinePosOri.size();
+		unsigned int kept = 0;
+		float arc = 0.0f, turn = 0.0f;
+		samplePositions.push_back(trackSplinePosOri[0]);
+		sampleCrosses.push_back(trackSplineCrossOri[0]);
+		sampleShapes.push_back(trackSplineShapeOri[0]);
+		for (unsigned int i = 1; i < splineNum; i++) {
+			float stepArc = glm::length(trackSplinePosOri[i] - trackSplinePosOri[i - 1]);
+			float stepTurn = glm::length(trackSplineShapeOri[i].tangent - trackSplineShapeOri[i - 1].tangent);
+			float nextArc = arc + stepArc, nextTurn = turn + stepTurn;
+			if (i - 1 > kept && nextArc * nextTurn * nextTurn / 24.0f >= 0.001f) {
+				kept = i - 1;
+				samplePositions.push_back(trackSplinePosOri[kept]);
+				sampleCrosses.push_back(trackSplineCrossOri[kept]);
+				sampleShapes.push_back(trackSplineShapeOri[kept]);
+				nextArc = stepArc;
+				nextTurn = stepTurn;
+			}
+			arc = nextArc;
+			turn = nextTurn;
+		}
+		if (kept + 1 < splineNum) {
+			samplePositions.push_back(trackSplinePosOri[splineNum - 1]);
+			sampleCrosses.push_back(trackSplineCrossOri[splineNum - 1]);
+			sampleShapes.push_back(trackSplineShapeOri[splineNum - 1]);
+		}
+	}
+	else {
+		// copied, the cache keeps its samples for the next build
+		samplePositions.assign(trackSplinePosOri.begin(), trackSplinePosOri.end());
+		sampleCrosses.assign(trackSplineCrossOri.begin(), trackSplineCrossOri.end());
+		sampleShapes.assign(trackSplineShapeOri.begin(), trackSplineShapeOri.end());
+	}
+
+	// the old TrackData may still be in use, always start a new one.
+	// without the adaptive pass the samples are the spline's own, the
+	// blocks no evaluated segment reaches are the last build's
+	result.track = std::make_shared<TrackData>();
+	TrackData& track = *result.track;
+	bool reuse = previous && !input.adaptive && previous->size() == samplePositions.size() &&
+		cache->trackWidth == input.trackWidth;
+	std::vector<unsigned char>& changedBlocks = cache->changedBlocks;
+	if (reuse) {
+		unsigned int blockSize = TrackData::BLOCK_SIZE;
+		changedBlocks.assign((samplePositions.size() + blockSize - 1) / blockSize, 0);
+		for (unsigned int i = 0; i < verticesNum; i++) {
+			if (!cache->evaluated[i]) continue;
+			unsigned int beg = i * input.divideLine, end = beg + input.divideLine;
+			for (unsigned int blockIdx = beg / blockSize; blockIdx * blockSize < end; blockIdx++)
+				changedBlocks[blockIdx] = 1;
+		}
+		track.assign(samplePositions, sampleCrosses, sampleShapes, input.trackWidth, *previous, changedBlocks);
+	}
+	else
+		track.assign(samplePositions, sampleCrosses, sampleShapes, input.trackWidth);
+	unsigned int sampleNum = track.size();
+	if (stale()) return false;
+
+	result.streamed = input.streamSamples > 0 && sampleNum > input.streamSamples;
+	result.supportPositions.clear();
+	result.supportNormals.clear();
+	if (result.streamed) {
+		result.trackMesh = std::make_shared<MeshData>();
+		result.sleeperTransforms.clear();
+	}
+	else {
+		// track model
+		buildTrackMesh(result);
+		if (stale()) return false;
+
+		// sleepers, and in the same sweep a support under every few of them
+		// where the track is off the ground
+		TrackSweep sweep(track, input.sleeperSpacing);
+		placeSleepers(sweep, input.supportEvery, result.sleeperTransforms, result.supportPositions, result.supportNormals);
+	}
+	result.supportMesh = std::make_shared<MeshData>();
+	result.supportMesh->loadVertices(result.supportPositions, result.supportNormals);
+	if (stale()) return false;
+
+	// trees standing in a flat box around any piece of track are hidden.
+	// each tree counts the boxes it stands in; after an edit only the
+	// samples of changed blocks are counted again, and the sample before
+	// each of those blocks, whose box reaches into it
+	unsigned int treesNum = (unsigned int)input.treePositions.size();
+	std::vector<unsigned int>& treeHits = cache->treeHits;
+	if (reuse && cache->treePositions == input.treePositions && treeHits.size() == treesNum) {
+		unsigned int blockNum = (unsigned int)changedBlocks.size();
+		for (unsigned int blockIdx = 0; blockIdx < blockNum; blockIdx++) {
+			if (!changedBlocks[blockIdx]) continue;
+			if (stale()) return false;
+			unsigned int beg = blockIdx * TrackData::BLOCK_SIZE;
+			unsigned int end = std::min(beg + (unsigned int)TrackData::BLOCK_SIZE, sampleNum);
+			unsigned int before = (beg + sampleNum - 1) % sampleNum;
+			if (!changedBlocks[before / TrackData::BLOCK_SIZE]) {
+				countTrees(*previous, before, input.treePositions, treeHits, -1);
+				countTrees(track, before, input.treePositions, treeHits, 1);
+			}
+			for (unsigned int trackIdx = beg; trackIdx < end; trackIdx++) {
+				countTrees(*previous, trackIdx, input.treePositions, treeHits, -1);
+				countTrees(track, trackIdx, input.treePositions, treeHits, 1);
+			}
+		}
+	}
+	else {
+		treeHits.assign(treesNum, 0);
+		for (unsigned int trackIdx = 0; trackIdx < sampleNum; trackIdx++) {
+			if ((trackIdx & 4095) == 4095 && stale()) return false;
+			countTrees(track, trackIdx, input.treePositions, treeHits, 1);
+		}
+	}
+	result.treeOnTrack.resize(treesNum);
+	for (unsigned int treesIdx = 0; treesIdx < treesNum; treesIdx++)
+		result.treeOnTrack[treesIdx] = treeHits[treesIdx] > 0;
+	if (stale()) return false;
+
+	// a complete build, the next one may carry its blocks and counts over
+	if (!input.adaptive) {
+		cache->track = result.track;
+		cache->trackWidth = input.trackWidth;
+		cache->treePositions = input.treePositions;
+	}
+	return true;
+}
+
+// add one (or take one with add -1) to the count of every tree standing in
+// the flat box around sample idx
+void TrackBuilder::countTrees(const TrackData& track, unsigned int idx, const std::vector<glm::vec3>& trees,
+	std::vector<unsigned int>& hits, int add) {
+	unsigned int treesNum = (unsigned int)trees.size();
+	glm::vec3 trackPos = track.position(idx);
+	glm::vec3 trackDirect = track.direct(idx);
+	glm::vec3 new_z = glm::normalize(trackDirect);
+	glm::vec3 new_y = glm::normalize(glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::vec3 new_x = glm::normalize(glm::cross(new_z, new_y));
+
+	// the box reaches 10 to the sides, 25 up and down and the segment's
+	// length ahead. the frame below isn't orthogonal (new_y stays up), it
+	// shrinks distances by at most sqrt(1 - |new_z.y|). skip the samples
+	// no tree is near
+	float squeeze = sqrtf(fmaxf(1.0f - fabsf(new_z.y), 0.0f));
+	if (squeeze > 0.01f) {
+		float reach = (glm::length(trackDirect) + 30.0f) / squeeze;
+		bool treeNear = false;
+		for (unsigned int treesIdx = 0; treesIdx < treesNum && !treeNear; treesIdx++) {
+			glm::vec3 offset = trees[treesIdx] - trackPos;
+			treeNear = glm::dot(offset, offset) < reach * reach;
+		}
+		if (!treeNear) return;
+	}
+
+	glm::mat4 trackTransform(1.0f);
+	trackTransform = glm::translate(-trackPos) * trackTransform;
+	trackTransform = glm::mat4(
+		new_x.x, new_x.y, new_x.z, 0.0f,
+		new_y.x, new_y.y, new_y.z, 0.0f,
+		new_z.x, new_z.y, new_z.z, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	) * trackTransform;
+	trackTransform = glm::scale(glm::vec3(0.1f, 0.04f, 0.1f / glm::length(trackDirect))) * trackTransform;
+
+	for (unsigned int treesIdx = 0; treesIdx < treesNum; treesIdx++) {
+		glm::vec3 treeProj = trackTransform * glm::vec4(trees[treesIdx], 1.0f);
+		if (-1.0f < treeProj.x && treeProj.x < 1.0f &&
+			-1.0f < treeProj.y && treeProj.y < 1.0f &&
+			0.0f < treeProj.z && treeProj.z < 1.0f)
+			hits[treesIdx] += add;
+	}
+}
+
+void TrackBuilder::setSpline(TrackBuildInput& input, int splineType, float tension) {
+	input.splineType = splineType;
+	// the basis the kernel uses, so the cache only misses when the curve
+	// changes: the tension moves nothing but the cardinal spline
+	if (splineType == SPLINE_CARDINAL) input.basis = cardinalBasis(tension);
+	else if (splineType == SPLINE_BSPLINE) input.basis = bsplineBasis;
+	else input.basis = SplineBasis{};
+	input.divideLine = (splineType == SPLINE_LINEAR) ? 1 : 100;
+}
+template <int Type>
+void TrackBuilder::evaluateSegments(const TrackBuildInput& input, const std::vector<glm::vec3>& trackCross, TrackSplineCache& cache) {
+	const std::vector<glm::vec3>& positions = input.positions;
+	unsigned int verticesNum = (unsigned int)positions.size();
+	unsigned int divideLine = input.divideLine;
+	for (unsigned int i = 0; i < verticesNum; i++) {
+		if (!cache.evaluated[i]) continue;
+		unsigned int i1 = (i + 1) % verticesNum, i2 = (i + 2) % verticesNum, i3 = (i + 3) % verticesNum;
+		SplineKernel<Type>::segment(input.basis, positions[i], positions[i1], positions[i2], positions[i3],
+			divideLine, &cache.splinePos[i * divideLine], &cache.splineShape[i * divideLine]);
+		SplineKernel<Type>::segment(input.basis, trackCross[i], trackCross[i1], trackCross[i2], trackCross[i3],
+			divideLine, &cache.splineCross[i * divideLine]);
+	}
+}
+unsigned int TrackBuilder::updateSpline(const TrackBuildInput& input, const std::vector<glm::vec3>& trackCross, TrackSplineCache& cache) {
+	unsigned int verticesNum = (unsigned int)input.positions.size();
+	unsigned int divideLine = input.divideLine;
+	// added or removed points shift every segment, start over
+	bool reuse = cache.positions.size() == verticesNum && cache.divideLine == divideLine &&
+		cache.splineType == input.splineType && cache.basis == input.basis && cache.splinePos.size() == verticesNum * divideLine;
+	std::vector<unsigned char>& moved = cache.moved;
+	moved.assign(verticesNum, 0);
+	if (reuse) {
+		for (unsigned int i = 0; i < verticesNum; i++)
+			moved[i] = input.positions[i] != cache.positions[i] || input.orients[i] != cache.orients[i];
+	}
+	cache.splinePos.resize(verticesNum * divideLine);
+	cache.splineCross.resize(verticesNum * divideLine);
+	cache.splineShape.resize(verticesNum * divideLine);
+
+	// segment i runs through points i to i+3, and their cross vectors also
+	// lean on the points either side, so it changes with points i-1 to i+4
+	unsigned int evaluated = 0;
+	cache.evaluated.assign(verticesNum, 0);
+	for (unsigned int i = 0; i < verticesNum; i++) {
+		bool dirty = !reuse;
+		for (unsigned int j = 0; j < 6 && !dirty; j++)
+			dirty = moved[(i + verticesNum - 1 + j) % verticesNum] != 0;
+		if (!dirty) continue;
+		cache.evaluated[i] = 1;
+		evaluated++;
+	}
+	// the type is picked once here, not for every sample
+	if (input.splineType == SPLINE_CARDINAL)
+		evaluateSegments<SPLINE_CARDINAL>(input, trackCross, cache);
+	else if (input.splineType == SPLINE_BSPLINE)
+		evaluateSegments<SPLINE_BSPLINE>(input, trackCross, cache);
+	else
+		evaluateSegments<SPLINE_LINEAR>(input, trackCross, cache);
+
+	cache.positions = input.positions;
+	cache.orients = input.orients;
+	cache.splineType = input.splineType;
+	cache.basis = input.basis;
+	cache.divideLine = divideLine;
+	return evaluated;
+}
+
+
+void TrackBuilder::buildTrackMesh(TrackBuildResult& result) {
+	std::vector<glm::vec3>& verticesPosition = result.railPositions;
+	std::vector<glm::vec3>& verticesNormal = result.railNormals;
+	verticesPosition.clear();
+	verticesNormal.clear();
+	unsigned int sampleNum = result.track->size();
+	verticesPosition.reserve(sampleNum * 32);
+	verticesNormal.reserve(sampleNum * 32);
+	buildRails(*result.track, 0, sampleNum, verticesPosition, verticesNormal);
+	// the mesh on screen is shared with the model drawing it, always make a new one
+	result.trackMesh = std::make_shared<MeshData>();
+	result.trackMesh->loadVertices(verticesPosition, verticesNormal);
+}
+
+// two square rails, each segment a box of four quads between the samples
+void TrackBuilder::buildRails(const TrackData& track, unsigned int beg, unsigned int end,
+	std::vector<glm::vec3>& verticesPosition, std::vector<glm::vec3>& verticesNormal) {
+	unsigned int sampleNum = track.size();
+	for (int rail = 0; rail < 2; rail++) {
+		for (unsigned int i = beg; i < end; i++) {
+			unsigned int nextIdx = (i + 1) % sampleNum;
+			glm::vec3 begCross = track.cross(i);
+			glm::vec3 endCross = track.cross(nextIdx);
+			glm::vec3 begUp = glm::normalize(glm::cross(track.tangent(i), begCross));
+			glm::vec3 endUp = glm::normalize(glm::cross(track.tangent(nextIdx), endCross));
+			glm::vec3 begPos = (rail == 0) ? track.leftRail(i) : track.rightRail(i);
+			glm::vec3 endPos = (rail == 0) ? track.leftRail(nextIdx) : track.rightRail(nextIdx);
+
+			//top
+			verticesPosition.push_back(begPos + begCross * 0.375f + begUp * 0.375f);
+			verticesPosition.push_back(begPos - begCross * 0.375f + begUp * 0.375f);
+			verticesPosition.push_back(endPos - endCross * 0.375f + endUp * 0.375f);
+			verticesPosition.push_back(endPos + endCross * 0.375f + endUp * 0.375f);
+			verticesNormal.push_back(glm::normalize(begUp));
+			verticesNormal.push_back(glm::normalize(begUp));
+			verticesNormal.push_back(glm::normalize(endUp));
+			verticesNormal.push_back(glm::normalize(endUp));
+			//bottom
+			verticesPosition.push_back(begPos + begCross * 0.375f - begUp * 0.375f);
+			verticesPosition.push_back(begPos - begCross * 0.375f - begUp * 0.375f);
+			verticesPosition.push_back(endPos - endCross * 0.375f - endUp * 0.375f);
+			verticesPosition.push_back(endPos + endCross * 0.375f - endUp * 0.375f);
+			verticesNormal.push_back(glm::normalize(-begUp));
+			verticesNormal.push_back(glm::normalize(-begUp));
+			verticesNormal.push_back(glm::normalize(-endUp));
+			verticesNormal.push_back(glm::normalize(-endUp));
+			//left
+			verticesPosition.push_back(begPos + begCross * 0.375f + begUp * 0.375f);
+			verticesPosition.push_back(begPos + begCross * 0.375f - begUp * 0.375f);
+			verticesPosition.push_back(endPos + endCross * 0.375f - endUp * 0.375f);
+			verticesPosition.push_back(endPos + endCross * 0.375f + endUp * 0.375f);
+			verticesNormal.push_back(glm::normalize(begCross));
+			verticesNormal.push_back(glm::normalize(begCross));
+			verticesNormal.push_back(glm::normalize(endCross));
+			verticesNormal.push_back(glm::normalize(endCross));
+			//right
+			verticesPosition.push_back(begPos - begCross * 0.375f + begUp * 0.375f);
+			verticesPosition.push_back(begPos - begCross * 0.375f - begUp * 0.375f);
+			verticesPosition.push_back(endPos - endCross * 0.375f - endUp * 0.375f);
+			verticesPosition.push_back(endPos - endCross * 0.375f + endUp * 0.375f);
+			verticesNormal.push_back(glm::normalize(-begCross));
+			verticesNormal.push_back(glm::normalize(-begCross));
+			verticesNormal.push_back(glm::normalize(-endCross));
+			verticesNormal.push_back(glm::normalize(-endCross));
+		}
+	}
+}
+
+void TrackBuilder::placeSleepers(TrackSweep& sweep, unsigned int supportEvery, std::vector<glm::mat4>& sleeperTransforms,
+	std::vector<glm::vec3>& supportPositions, std::vector<glm::vec3>& supportNormals) {
+	sleeperTransforms.resize(sweep.count());
+	TrackSpot spot;
+	for (unsigned int i = 0; sweep.next(spot); i++) {
+		sleeperTransforms[i] = spotTransform(spot, 0.15f);
+		// counted along the whole track so pieces of it agree
+		if (supportEvery > 0 && spot.index % supportEvery == 0)
+			addSupport(spot, supportPositions, supportNormals);
+	}
+}
+
+// a square column from under the sleeper straight down to the ground,
+// four quads with the faces turned along the track
+void TrackBuilder::addSupport(const TrackSpot& spot, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals) {
+	const float halfWidth = 0.75f;
+	// upside down or steeply banked track would have it go through the rails
+	if (spot.up.y < 0.5f) return;
+	glm::vec3 top = spot.position - spot.up * 1.0f;
+	glm::vec3 bottom;
+	if (!castToGround(top, bottom)) return;
+	// resting on the ground already
+	if (top.y - bottom.y < 1.0f) return;
+
+	glm::vec3 front(spot.forward.x, 0.0f, spot.forward.z);
+	front = (glm::length(front) > 0.001f) ? glm::normalize(front) : glm::vec3(0.0f, 0.0f, 1.0f);
+	glm::vec3 side(front.z, 0.0f, -front.x);
+	glm::vec3 corners[4] = {
+		(side + front) * halfWidth,
+		(-side + front) * halfWidth,
+		(-side - front) * halfWidth,
+		(side - front) * halfWidth
+	};
+	glm::vec3 faceNormals[4] = { front, -side, -front, side };
+	for (int face = 0; face < 4; face++) {
+		glm::vec3 a = corners[face];
+		glm::vec3 b = corners[(face + 1) % 4];
+		positions.push_back(bottom + b);
+		positions.push_back(bottom + a);
+		positions.push_back(top + a);
+		positions.push_back(top + b);
+		for (int i = 0; i < 4; i++)
+			normals.push_back(faceNormals[face]);
+	}
+}
+
+bool TrackBuilder::castToGround(const glm::vec3& origin, glm::vec3& hit) {
+	if (origin.y <= 0.0f) return false;
+	hit = glm::vec3(origin.x, 0.0f, origin.z);
+	return true;
+}
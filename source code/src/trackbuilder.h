@@ -0,0 +1,158 @@
+#pragma once
+
+#include "model.h"
+#include "tracksamples.h"
+#include "splinekernel.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// everything a track rebuild reads, copied from the track and the widgets
+// on the UI thread so the build never touches them
+struct TrackBuildInput {
+	std::vector<glm::vec3> positions;	// control points
+	std::vector<glm::vec3> orients;
+	int splineType;						// SplineType, picks the kernel
+	SplineBasis basis;					// of the cubic splines, zero for linear
+	unsigned int divideLine;			// samples per control point
+	bool adaptive;						// drop samples on straight parts
+	float trackWidth;
+	float sleeperSpacing;
+	unsigned int supportEvery;			// a support under every n-th sleeper, 0 for none
+	unsigned int streamSamples;			// past this many samples only the samples are built, 0 never
+	std::vector<glm::vec3> treePositions;
+};
+
+// the rebuilt track: the samples, the rail mesh and the sleepers.
+// a finished result is swapped into the view as a whole
+struct TrackBuildResult {
+	std::shared_ptr<TrackData> track;
+	std::vector<glm::vec3> controlDirects;	// scratch, one per control point
+	std::vector<glm::vec3> controlCrosses;
+	std::vector<glm::vec3> samplePositions;	// scratch for track
+	std::vector<glm::vec3> sampleCrosses;
+	std::vector<SplineShape> sampleShapes;
+	std::shared_ptr<MeshData> trackMesh;
+	std::vector<glm::vec3> railPositions;	// scratch for trackMesh
+	std::vector<glm::vec3> railNormals;
+	std::vector<glm::mat4> sleeperTransforms;
+	std::shared_ptr<MeshData> supportMesh;	// every support merged into one mesh
+	std::vector<glm::vec3> supportPositions;	// scratch for supportMesh
+	std::vector<glm::vec3> supportNormals;
+	std::vector<unsigned char> treeOnTrack;	// one flag per tree position
+	bool streamed;		// too long to build whole: the meshes and sleepers are
+						// left empty, TrackChunkCache makes them around the train
+	unsigned int splineSegments;			// control point segments evaluated, the rest came from the cache
+};
+
+// the spline samples of the last build and the control points they came
+// from. the next build compares the points and only evaluates the segments
+// a moved point reaches, so editing a few points of a long track doesn't
+// evaluate all of it again
+struct TrackSplineCache {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> orients;
+	int splineType;
+	SplineBasis basis;
+	unsigned int divideLine;
+	std::vector<glm::vec3> splinePos;	// divideLine samples per control point
+	std::vector<glm::vec3> splineCross;
+	std::vector<SplineShape> splineShape;	// of splinePos
+	std::vector<unsigned char> moved;	// scratch, one flag per control point
+	std::vector<unsigned char> evaluated;	// the segments the last build evaluated
+	std::vector<unsigned char> changedBlocks;	// scratch, one flag per TrackData block
+
+	// what the last complete build made of splinePos, so the next one can
+	// copy the blocks of samples and the tree counts it doesn't change.
+	// empty after an adaptive or cancelled build
+	std::shared_ptr<const TrackData> track;
+	float trackWidth;
+	std::vector<glm::vec3> treePositions;
+	std::vector<unsigned int> treeHits;	// how many sample boxes each tree stands in
+};
+
+// Rebuilds the track on a worker thread so editing never waits for it.
+// request() hands over a new input; a build still running for an older
+// request notices the newer generation and gives up. The worker builds into
+// a back buffer and swaps it with the ready one when done, takeResult()
+// swaps the ready one out on the UI thread. The old vectors travel back the
+// same way, so steady editing reuses their memory (not the TrackData, that
+// is new every time since others may still hold the old one).
+struct TrackSpot;
+class TrackSweep;
+
+class TrackBuilder {
+public:
+	TrackBuilder();
+	~TrackBuilder();
+	// queue a rebuild, cancelling the one before it. returns its generation
+	unsigned long request(const TrackBuildInput& input);
+	// drop queued, running and finished builds (a synchronous build replaced them)
+	void cancel();
+	// swap the newest finished build into result (UI thread only),
+	// false if nothing new is ready
+	bool takeResult(TrackBuildResult& result);
+	// true while a request is queued or being built
+	bool busy();
+	// called on the worker thread every time a build is ready
+	void setReadyCallback(void (*callback)(void*), void* data);
+
+	// the build itself, usable on any thread. returns false without a
+	// complete result when there are fewer than 4 points, or when latest
+	// is given and moves past generation while building. with a cache the
+	// spline segments the last build left there are reused where they can be
+	static bool build(const TrackBuildInput& input, TrackBuildResult& result, TrackSplineCache* cache = NULL,
+		const std::atomic<unsigned long>* latest = NULL, unsigned long generation = 0);
+	// the spline type of the input, its basis and the samples per segment
+	// it is drawn with. tension is for the cardinal spline only
+	static void setSpline(TrackBuildInput& input, int splineType, float tension);
+	// the rails between samples beg and end (not included), appended as quads.
+	// a range of the track builds the same quads the whole track has there
+	static void buildRails(const TrackData& track, unsigned int beg, unsigned int end,
+		std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals);
+	// a sleeper at every spot of the sweep and a support under every
+	// supportEvery-th one, supports appended as quads
+	static void placeSleepers(TrackSweep& sweep, unsigned int supportEvery, std::vector<glm::mat4>& sleeperTransforms,
+		std::vector<glm::vec3>& supportPositions, std::vector<glm::vec3>& supportNormals);
+private:
+	// bring the cache up to the input's control points, returns the number
+	// of segments evaluated
+	static unsigned int updateSpline(const TrackBuildInput& input, const std::vector<glm::vec3>& trackCross, TrackSplineCache& cache);
+	// the segments flagged in cache.evaluated, with the kernel of one type
+	template <int Type>
+	static void evaluateSegments(const TrackBuildInput& input, const std::vector<glm::vec3>& trackCross, TrackSplineCache& cache);
+	static void buildTrackMesh(TrackBuildResult& result);
+	static void countTrees(const TrackData& track, unsigned int idx, const std::vector<glm::vec3>& trees,
+		std::vector<unsigned int>& hits, int add);
+	static void addSupport(const TrackSpot& spot, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals);
+	// where a ray straight down from origin meets the ground (y = 0)
+	static bool castToGround(const glm::vec3& origin, glm::vec3& hit);
+	void workerLoop();
+private:
+	std::atomic<unsigned long> latest;	// generation of the newest request
+
+	// shared with the worker, guarded by lock
+	std::mutex lock;
+	std::condition_variable jobReady;
+	bool hasJob;
+	bool building;
+	TrackBuildInput job;
+	unsigned long jobGeneration;
+	TrackBuildResult ready;
+	bool readyValid;
+	bool stopping;
+	void (*readyCallback)(void*);
+	void* readyData;
+
+	TrackBuildResult back;	// worker only
+	TrackSplineCache splineCache;	// worker only
+	std::thread worker;
+private:
+	TrackBuilder(const TrackBuilder&);
+	TrackBuilder& operator=(const TrackBuilder&);
+};
@@ -0,0 +1,303 @@
+#include "trackbundle.h"
+
+#include "Track.H"
+#include "atomicfile.h"
+#include "mappedfile.h"
+#include "model.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char BUNDLE_MAGIC[4] = { 'R', 'C', 'T', 'B' };
+static const uint32_t BUNDLE_VERSION = 4;
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t splineType;
+	float tension;
+	uint32_t divideLine;
+	uint32_t adaptive;
+	float trackWidth;
+	float sleeperSpacing;
+	uint32_t supportEvery;
+	uint32_t pointNum;
+	uint32_t blockNum;
+	uint32_t sampleNum;
+	uint32_t sleeperNum;
+	uint32_t treeNum;
+	float railGap;
+	uint32_t reserved;
+	// where each section starts, 0 for an empty one
+	uint64_t pointsAt;
+	uint64_t blocksAt;
+	uint64_t samplesAt;
+	uint64_t lengthsAt;
+	uint64_t sleepersAt;
+	uint64_t treesAt;
+	uint64_t railsAt;
+	uint64_t supportsAt;
+}TrackBundleHeader;
+
+static_assert(sizeof(TrackBundleHeader) == 128, "the bundle header must have no padding");
+static_assert(sizeof(ControlPoint) == 6 * sizeof(float), "ControlPoint is stored as it is in memory");
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "glm::mat4 is stored as it is in memory");
+
+TrackBakeSettings::TrackBakeSettings() {
+	// what the window starts with
+	TrackBakeSettings::splineType = SPLINE_CARDINAL;
+	TrackBakeSettings::tension = 0.0f;
+	TrackBakeSettings::divideLine = 0;
+	TrackBakeSettings::adaptive = false;
+	TrackBakeSettings::trackWidth = 5.0f;
+	TrackBakeSettings::sleeperSpacing = 10.0f;
+	TrackBakeSettings::supportEvery = 2;
+}
+
+// zeros up to the next 8 byte boundary
+static bool padSection(FILE* fp, uint64_t& offset) {
+	static const unsigned char zeros[8] = { 0 };
+	size_t pad = (size_t)((8 - offset % 8) % 8);
+	offset += pad;
+	return fwrite(zeros, 1, pad, fp) == pad;
+}
+
+static bool writeSection(FILE* fp, const void* data, size_t size, uint64_t& offset, uint64_t& at) {
+	at = size ? offset : 0;
+	if (size && fwrite(data, 1, size, fp) != size) return false;
+	offset += size;
+	return padSection(fp, offset);
+}
+
+static bool writeMeshSection(FILE* fp, const std::shared_ptr<MeshData>& mesh, uint64_t& offset, uint64_t& at) {
+	at = 0;
+	if (!mesh || mesh->vertexNum == 0) return true;
+	size_t size;
+	if (mesh->writeMeshSection(fp, size) != 0) return false;
+	at = offset;
+	offset += size;
+	return padSection(fp, offset);
+}
+
+// count items of itemSize at at lie in the file after the header, 8 byte
+// aligned
+static bool sectionFits(const MappedFile& file, uint64_t at, size_t count, size_t itemSize) {
+	if (count == 0) return true;
+	return at % 8 == 0 && at >= sizeof(TrackBundleHeader) && at <= file.size() &&
+		(file.size() - at) / itemSize >= count;
+}
+
+bool TrackBundle::bake(const std::vector<ControlPoint>& points, const TrackBakeSettings& settings,
+	const std::vector<glm::vec3>& treePositions, const char* fileName) {
+	TrackBuildInput input;
+	TrackBuilder::setSpline(input, settings.splineType, settings.tension);
+	if (settings.divideLine > 0) input.divideLine = settings.divideLine;
+	input.adaptive = settings.adaptive;
+	input.trackWidth = settings.trackWidth;
+	input.sleeperSpacing = settings.sleeperSpacing;
+	input.supportEvery = settings.supportEvery;
+	// the whole track, however long
+	input.streamSamples = 0;
+	input.positions.resize(points.size());
+	input.orients.resize(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		input.positions[i] = glm::vec3(points[i].pos.x, points[i].pos.y, points[i].pos.z);
+		input.orients[i] = glm::vec3(points[i].orient.x, points[i].orient.y, points[i].orient.z);
+	}
+	input.treePositions = treePositions;
+
+	TrackBuildResult result;
+	if (!TrackBuilder::build(input, result)) return false;
+	// divideLine stays 0 unless --divide asked for one, so a later build
+	// with another spline type uses that type's own
+	return write(fileName, points, settings, result);
+}
+
+bool TrackBundle::write(const char* fileName, const std::vector<ControlPoint>& points,
+	const TrackBakeSettings& settings, const TrackBuildResult& result) {
+	if (!result.track || result.track->empty()) return false;
+	const TrackData& track = *result.track;
+
+	TrackBundleHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BUNDLE_MAGIC, 4);
+	header.version = BUNDLE_VERSION;
+	header.splineType = (uint32_t)settings.splineType;
+	header.tension = settings.tension;
+	header.divideLine = settings.divideLine;
+	header.adaptive = settings.adaptive ? 1 : 0;
+	header.trackWidth = settings.trackWidth;
+	header.sleeperSpacing = settings.sleeperSpacing;
+	header.supportEvery = settings.supportEvery;
+	header.pointNum = (uint32_t)points.size();
+	header.blockNum = (uint32_t)track.blocks.size();
+	header.sampleNum = (uint32_t)track.samples.size();
+	header.sleeperNum = (uint32_t)result.sleeperTransforms.size();
+	header.treeNum = (uint32_t)result.treeOnTrack.size();
+	header.railGap = track.railGap;
+
+	AtomicFile file;
+	if (!file.open(fileName, true)) return false;
+	FILE* fp = file.stream();
+	// the header goes in again at the end, with the offsets
+	uint64_t offset = sizeof(header);
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	ok = ok && writeSection(fp, points.empty() ? NULL : &points[0], points.size() * sizeof(ControlPoint), offset, header.pointsAt);
+	ok = ok && writeSection(fp, &track.blocks[0], track.blocks.size() * sizeof(TrackData::Block), offset, header.blocksAt);
+	ok = ok && writeSection(fp, &track.samples[0], track.samples.size() * sizeof(TrackData::Sample), offset, header.samplesAt);
+	ok = ok && writeSection(fp, &track.runningLength[0], track.runningLength.size() * sizeof(float), offset, header.lengthsAt);
+	ok = ok && writeSection(fp, result.sleeperTransforms.empty() ? NULL : &result.sleeperTransforms[0],
+		result.sleeperTransforms.size() * sizeof(glm::mat4), offset, header.sleepersAt);
+	ok = ok && writeSection(fp, result.treeOnTrack.empty() ? NULL : &result.treeOnTrack[0], result.treeOnTrack.size(), offset, header.treesAt);
+	ok = ok && writeMeshSection(fp, result.trackMesh, offset, header.railsAt);
+	ok = ok && writeMeshSection(fp, result.supportMesh, offset, header.supportsAt);
+	ok = ok && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (!ok) {
+		file.abandon();
+		return false;
+	}
+	return file.commit();
+}
+
+bool TrackBundle::load(const char* fileName, unsigned int streamSamples, std::vector<ControlPoint>& points,
+	TrackBakeSettings& settings, TrackBuildResult& result, TrackParseError& error) {
+	error.line = 0;
+	error.column = 0;
+	MappedFile file;
+	if (!file.open(fileName)) {
+		error.message = "can't open the file";
+		return false;
+	}
+	TrackBundleHeader header;
+	if (file.size() < sizeof(header)) {
+		error.message = "not a track bundle";
+		return false;
+	}
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, BUNDLE_MAGIC, 4) != 0 || header.version != BUNDLE_VERSION) {
+		error.message = "not a track bundle, or one from another version";
+		return false;
+	}
+	bool valid = header.pointNum >= 4 && header.sampleNum > 0 &&
+		header.blockNum == (header.sampleNum + TrackData::BLOCK_SIZE - 1) / TrackData::BLOCK_SIZE &&
+		sectionFits(file, header.pointsAt, header.pointNum, sizeof(ControlPoint)) &&
+		sectionFits(file, header.blocksAt, header.blockNum, sizeof(TrackData::Block)) &&
+		sectionFits(file, header.samplesAt, header.sampleNum, sizeof(TrackData::Sample)) &&
+		sectionFits(file, header.lengthsAt, header.sampleNum, sizeof(float)) &&
+		sectionFits(file, header.sleepersAt, header.sleeperNum, sizeof(glm::mat4)) &&
+		sectionFits(file, header.treesAt, header.treeNum, 1);
+	if (!valid) {
+		error.message = "the bundle is damaged";
+		return false;
+	}
+	const unsigned char* data = file.data();
+
+	std::shared_ptr<TrackData> track = std::make_shared<TrackData>();
+	track->blocks.resize(header.blockNum);
+	memcpy(&track->blocks[0], data + header.blocksAt, header.blockNum * sizeof(TrackData::Block));
+	track->samples.resize(header.sampleNum);
+	memcpy(&track->samples[0], data + header.samplesAt, header.sampleNum * sizeof(TrackData::Sample));
+	track->runningLength.resize(header.sampleNum);
+	memcpy(&track->runningLength[0], data + header.lengthsAt, header.sampleNum * sizeof(float));
+	track->railGap = header.railGap;
+
+	// a track too long to draw whole is streamed, as a build would
+	result.streamed = streamSamples > 0 && header.sampleNum > streamSamples;
+	result.trackMesh.reset();
+	result.supportMesh.reset();
+	result.sleeperTransforms.clear();
+	if (!result.streamed) {
+		if (header.railsAt) {
+			result.trackMesh = std::make_shared<MeshData>();
+			valid = result.trackMesh->loadMeshSection(fileName, (size_t)header.railsAt) == 0;
+		}
+		if (valid && header.supportsAt) {
+			result.supportMesh = std::make_shared<MeshData>();
+			valid = result.supportMesh->loadMeshSection(fileName, (size_t)header.supportsAt) == 0;
+		}
+		if (!valid) {
+			result.trackMesh.reset();
+			result.supportMesh.reset();
+			error.message = "a mesh in the bundle is damaged";
+			return false;
+		}
+		result.sleeperTransforms.resize(header.sleeperNum);
+		if (header.sleeperNum)
+			memcpy(&result.sleeperTransforms[0], data + header.sleepersAt, header.sleeperNum * sizeof(glm::mat4));
+	}
+	result.treeOnTrack.assign(data + header.treesAt, data + header.treesAt + header.treeNum);
+	result.track = track;
+	result.splineSegments = 0;
+
+	points.resize(header.pointNum);
+	memcpy(&points[0], data + header.pointsAt, header.pointNum * sizeof(ControlPoint));
+	settings.splineType = (int)header.splineType;
+	settings.tension = header.tension;
+	settings.divideLine = header.divideLine;
+	settings.adaptive = header.adaptive != 0;
+	settings.trackWidth = header.trackWidth;
+	settings.sleeperSpacing = header.sleeperSpacing;
+	settings.supportEvery = header.supportEvery;
+	return true;
+}
+
+int TrackBundle::runBaker(int argc, char** argv, const std::vector<glm::vec3>& treePositions) {
+	if (argc < 2) {
+		printf("usage: RollerCoasters --bake track.txt|track.glb out.bundle\n"
+			"         [--spline linear|cardinal|bspline] [--tension t] [--divide n]\n"
+			"         [--adaptive] [--width w] [--sleepers spacing] [--supports every]\n");
+		return 1;
+	}
+	const char* inName = argv[0];
+	const char* outName = argv[1];
+	TrackBakeSettings settings;
+	for (int argIdx = 2; argIdx < argc; argIdx++) {
+		const char* option = argv[argIdx];
+		const char* value = (argIdx + 1 < argc) ? argv[argIdx + 1] : NULL;
+		if (strcmp(option, "--adaptive") == 0) {
+			settings.adaptive = true;
+			continue;
+		}
+		if (value == NULL) {
+			printf("%s needs a value\n", option);
+			return 1;
+		}
+		argIdx++;
+		if (strcmp(option, "--spline") == 0) {
+			if (strcmp(value, "linear") == 0) settings.splineType = SPLINE_LINEAR;
+			else if (strcmp(value, "cardinal") == 0) settings.splineType = SPLINE_CARDINAL;
+			else if (strcmp(value, "bspline") == 0) settings.splineType = SPLINE_BSPLINE;
+			else {
+				printf("unknown spline %s\n", value);
+				return 1;
+			}
+		}
+		else if (strcmp(option, "--tension") == 0) settings.tension = (float)atof(value);
+		else if (strcmp(option, "--divide") == 0) settings.divideLine = (unsigned int)atoi(value);
+		else if (strcmp(option, "--width") == 0) settings.trackWidth = (float)atof(value);
+		else if (strcmp(option, "--sleepers") == 0) settings.sleeperSpacing = (float)atof(value);
+		else if (strcmp(option, "--supports") == 0) settings.supportEvery = (unsigned int)atoi(value);
+		else {
+			printf("unknown option %s\n", option);
+			return 1;
+		}
+	}
+
+	CTrack track;
+	TrackParseError error;
+	if (!track.readPoints(inName, error)) {
+		if (error.line > 0)
+			printf("%s(%u,%u): %s\n", inName, error.line, error.column, error.message.c_str());
+		else
+			printf("%s: %s\n", inName, error.message.c_str());
+		return 1;
+	}
+	if (!bake(track.points, settings, treePositions, outName)) {
+		printf("Can't write %s\n", outName);
+		return 1;
+	}
+	printf("Baked %s into %s\n", inName, outName);
+	return 0;
+}
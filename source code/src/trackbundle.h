@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ControlPoint.H"
+#include "trackbuilder.h"
+#include "trackparser.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// what a bundle was baked with, the widgets are set to it when it is loaded
+struct TrackBakeSettings {
+	int splineType;			// SplineType
+	float tension;
+	unsigned int divideLine;	// samples per control point, 0 for the spline's own
+	bool adaptive;
+	float trackWidth;
+	float sleeperSpacing;
+	unsigned int supportEvery;
+	TrackBakeSettings();
+};
+
+// A track built offline for a layout that doesn't change: the control
+// points, the packed samples with their running lengths (the frames come
+// from the packed cross vectors), the sleeper transforms, the tree flags
+// and the rail and support meshes, each at an 8 byte aligned offset. The
+// file is mapped when loaded; the meshes are drawn from the mapping as the
+// binary mesh files are, the rest is copied out of it, nothing is built.
+// Baking the same points with the same settings writes the same bytes:
+// there are no times or pointers in it and all padding is zero.
+class TrackBundle {
+public:
+	// build the track the way TrackBuilder does and write it
+	static bool bake(const std::vector<ControlPoint>& points, const TrackBakeSettings& settings,
+		const std::vector<glm::vec3>& treePositions, const char* fileName);
+	static bool write(const char* fileName, const std::vector<ControlPoint>& points,
+		const TrackBakeSettings& settings, const TrackBuildResult& result);
+	// the result is complete, as if TrackBuilder::build made it. past
+	// streamSamples samples (0 never) the meshes are left out and the
+	// result is streamed, as a build would do
+	static bool load(const char* fileName, unsigned int streamSamples, std::vector<ControlPoint>& points,
+		TrackBakeSettings& settings, TrackBuildResult& result, TrackParseError& error);
+	// RollerCoasters --bake in out.bundle [options], see the usage it prints
+	static int runBaker(int argc, char** argv, const std::vector<glm::vec3>& treePositions);
+};
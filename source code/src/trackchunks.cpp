@@ -0,0 +1,190 @@
+#include "trackchunks.h"
+#include "trackbuilder.h"
+#include "trackplacement.h"
+
+#include <algorithm>
+#include <math.h>
+
+TrackChunk::TrackChunk() {
+	TrackChunk::index = 0;
+	TrackChunk::rails = NULL;
+	TrackChunk::sleepers = NULL;
+	TrackChunk::supports = NULL;
+	TrackChunk::lastWanted = 0;
+}
+
+TrackChunk::~TrackChunk() {
+	delete rails;
+	delete sleepers;
+	delete supports;
+}
+
+TrackChunkCache::TrackChunkCache() {
+	TrackChunkCache::chunkLength = 200.0f;
+	TrackChunkCache::viewRange = 500.0f;
+	TrackChunkCache::capacity = 64;
+	TrackChunkCache::buildBudget = 4;
+	TrackChunkCache::sleeperSpacing = 10.0f;
+	TrackChunkCache::supportEvery = 0;
+	TrackChunkCache::updateNum = 0;
+	TrackChunkCache::missing = false;
+}
+
+TrackChunkCache::~TrackChunkCache() {
+	clear();
+}
+
+void TrackChunkCache::clear() {
+	for (ChunkList::iterator it = chunks.begin(); it != chunks.end(); it++)
+		delete *it;
+	chunks.clear();
+	chunkMap.clear();
+	wanted.clear();
+	drawn.clear();
+	lastDrawn.clear();
+	missing = false;
+}
+
+void TrackChunkCache::setTrack(std::shared_ptr<const TrackData> track, float sleeperSpacing, unsigned int supportEvery) {
+	clear();
+	TrackChunkCache::track = track;
+	TrackChunkCache::sleeperSpacing = sleeperSpacing;
+	TrackChunkCache::supportEvery = supportEvery;
+	firstSample.clear();
+	boundsMin.clear();
+	boundsMax.clear();
+	if (!track || track->empty()) return;
+
+	// one walk over the samples: where each chunk starts and what it covers
+	unsigned int sampleNum = track->size();
+	unsigned int chunkNum = (unsigned int)ceilf(track->trackLength() / chunkLength);
+	if (chunkNum == 0) chunkNum = 1;
+	firstSample.resize(chunkNum + 1);
+	boundsMin.resize(chunkNum);
+	boundsMax.resize(chunkNum);
+	const std::vector<float>& lengths = track->lengths();
+	unsigned int sampleIdx = 0;
+	for (unsigned int chunkIdx = 0; chunkIdx < chunkNum; chunkIdx++) {
+		// the first segment starting at or after the chunk
+		float begin = chunkIdx * chunkLength;
+		while (sampleIdx < sampleNum && (sampleIdx == 0 ? 0.0f : lengths[sampleIdx - 1]) < begin)
+			sampleIdx++;
+		firstSample[chunkIdx] = sampleIdx;
+	}
+	firstSample[chunkNum] = sampleNum;
+	for (unsigned int chunkIdx = 0; chunkIdx < chunkNum; chunkIdx++) {
+		// from the sample before (a long segment may reach into the chunk)
+		// to the one ending its last segment
+		unsigned int beg = (firstSample[chunkIdx] > 0) ? firstSample[chunkIdx] - 1 : 0;
+		unsigned int end = firstSample[chunkIdx + 1];
+		glm::vec3 lo = track->position(beg), hi = lo;
+		for (unsigned int i = beg + 1; i <= end; i++) {
+			glm::vec3 pos = track->position(i % sampleNum);
+			lo = glm::min(lo, pos);
+			hi = glm::max(hi, pos);
+		}
+		boundsMin[chunkIdx] = lo;
+		boundsMax[chunkIdx] = hi;
+	}
+}
+
+bool TrackChunkCache::active() {
+	return !firstSample.empty();
+}
+
+bool TrackChunkCache::update(const glm::vec3* focus, unsigned int focusNum) {
+	if (!active()) return false;
+	updateNum++;
+
+	unsigned int chunkNum = (unsigned int)boundsMin.size();
+	wanted.clear();
+	for (unsigned int chunkIdx = 0; chunkIdx < chunkNum; chunkIdx++) {
+		for (unsigned int focusIdx = 0; focusIdx < focusNum; focusIdx++) {
+			glm::vec3 nearest = glm::max(boundsMin[chunkIdx], glm::min(focus[focusIdx], boundsMax[chunkIdx]));
+			if (glm::length(focus[focusIdx] - nearest) < viewRange) {
+				wanted.push_back(chunkIdx);
+				break;
+			}
+		}
+	}
+
+	// the wanted chunks move to the front, missing ones are built while the
+	// budget lasts
+	lastDrawn.swap(drawn);
+	drawn.clear();
+	unsigned int buildNum = 0;
+	missing = false;
+	for (unsigned int i = 0; i < wanted.size(); i++) {
+		std::unordered_map<unsigned int, ChunkList::iterator>::iterator found = chunkMap.find(wanted[i]);
+		if (found != chunkMap.end()) {
+			chunks.splice(chunks.begin(), chunks, found->second);
+		}
+		else if (buildNum < buildBudget) {
+			chunks.push_front(build(wanted[i]));
+			chunkMap[wanted[i]] = chunks.begin();
+			buildNum++;
+		}
+		else {
+			missing = true;
+			continue;
+		}
+		chunks.front()->lastWanted = updateNum;
+		drawn.push_back(wanted[i]);
+	}
+
+	// past capacity the chunks wanted longest ago go, never one wanted now
+	while (chunks.size() > capacity && chunks.back()->lastWanted != updateNum) {
+		chunkMap.erase(chunks.back()->index);
+		delete chunks.back();
+		chunks.pop_back();
+	}
+
+	return drawn != lastDrawn;
+}
+
+bool TrackChunkCache::pending() {
+	return missing;
+}
+
+void TrackChunkCache::draw(const ModelClass& sleeperModel, bool doingShadows) {
+	for (unsigned int i = 0; i < drawn.size(); i++) {
+		TrackChunk* chunk = *chunkMap[drawn[i]];
+		chunk->rails->draw(doingShadows, GL_QUADS);
+		// the sleeper mesh may have loaded after the chunk was built
+		if (chunk->sleepers->mesh != sleeperModel.mesh) {
+			chunk->sleepers->setMesh(sleeperModel.mesh);
+			chunk->sleepers->colors = sleeperModel.colors;
+		}
+		chunk->sleepers->draw(doingShadows);
+		chunk->supports->draw(doingShadows, GL_QUADS);
+	}
+}
+
+unsigned int TrackChunkCache::builtNum() {
+	return (unsigned int)chunks.size();
+}
+
+// the same rails, sleepers and supports a whole build makes over the chunk
+TrackChunk* TrackChunkCache::build(unsigned int chunkIdx) {
+	TrackChunk* chunk = new TrackChunk();
+	chunk->index = chunkIdx;
+
+	positions.clear();
+	normals.clear();
+	TrackBuilder::buildRails(*track, firstSample[chunkIdx], firstSample[chunkIdx + 1], positions, normals);
+	std::shared_ptr<MeshData> railMesh = std::make_shared<MeshData>();
+	railMesh->loadVertices(positions, normals);
+	chunk->rails = new ModelClass(railMesh);
+	chunk->rails->setColor(128, 128, 128);
+
+	supportPositions.clear();
+	supportNormals.clear();
+	TrackSweep sweep(*track, sleeperSpacing, chunkIdx * chunkLength, (chunkIdx + 1) * chunkLength);
+	chunk->sleepers = new ModelClass();
+	TrackBuilder::placeSleepers(sweep, supportEvery, chunk->sleepers->transforms, supportPositions, supportNormals);
+	std::shared_ptr<MeshData> supportMesh = std::make_shared<MeshData>();
+	supportMesh->loadVertices(supportPositions, supportNormals);
+	chunk->supports = new ModelClass(supportMesh);
+	chunk->supports->setColor(96, 88, 80);
+	return chunk;
+}
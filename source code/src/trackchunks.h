@@ -0,0 +1,84 @@
+#pragma once
+
+#include "model.h"
+#include "tracksamples.h"
+
+#include <glm/glm.hpp>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// one piece of a streamed track and everything drawn for it
+struct TrackChunk {
+	unsigned int index;
+	ModelClass* rails;
+	ModelClass* sleepers;
+	ModelClass* supports;
+	unsigned long lastWanted;	// the update that last wanted it
+	TrackChunk();
+	~TrackChunk();
+private:
+	TrackChunk(const TrackChunk&);
+	TrackChunk& operator=(const TrackChunk&);
+};
+
+// Draws a track too long to build whole. The track is cut into chunks of
+// chunkLength arc length; only the chunks near the train and the camera get
+// their rails, sleepers and supports built, a few per update so no frame
+// stalls on it. Chunks that aren't wanted any more stay around until more
+// than capacity are kept, then the ones wanted longest ago go first.
+// The samples themselves (TrackData) stay whole, the train and the
+// simulation thread need all of them.
+// UI thread only.
+class TrackChunkCache {
+public:
+	float chunkLength;			// arc length per chunk
+	float viewRange;			// chunks closer than this to a focus point are wanted
+	unsigned int capacity;		// chunks kept built
+	unsigned int buildBudget;	// chunks built per update
+public:
+	TrackChunkCache();
+	~TrackChunkCache();
+	// start over with a new track, NULL to stop streaming
+	void setTrack(std::shared_ptr<const TrackData> track, float sleeperSpacing, unsigned int supportEvery);
+	bool active();
+	// work out the chunks wanted around the focus points and build the
+	// missing ones, within the budget. returns true when the chunks draw()
+	// draws have changed
+	bool update(const glm::vec3* focus, unsigned int focusNum);
+	// wanted chunks the budget left for later updates
+	bool pending();
+	// the wanted chunks that are built. sleeperModel lends its mesh and color
+	void draw(const ModelClass& sleeperModel, bool doingShadows = false);
+	unsigned int builtNum();
+private:
+	typedef std::list<TrackChunk*> ChunkList;
+	TrackChunk* build(unsigned int chunkIdx);
+	void clear();
+private:
+	std::shared_ptr<const TrackData> track;
+	float sleeperSpacing;
+	unsigned int supportEvery;
+	// per chunk: the first sample whose segment starts in it, and its bounds
+	std::vector<unsigned int> firstSample;
+	std::vector<glm::vec3> boundsMin;
+	std::vector<glm::vec3> boundsMax;
+
+	ChunkList chunks;	// most recently wanted first
+	std::unordered_map<unsigned int, ChunkList::iterator> chunkMap;
+	std::vector<unsigned int> wanted;	// in the last update, ascending
+	std::vector<unsigned int> drawn;	// wanted and built at the last update
+	std::vector<unsigned int> lastDrawn;	// drawn before it, kept for its buffer
+	unsigned long updateNum;
+	bool missing;
+
+	// reused while building
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec3> supportPositions;
+	std::vector<glm::vec3> supportNormals;
+private:
+	TrackChunkCache(const TrackChunkCache&);
+	TrackChunkCache& operator=(const TrackChunkCache&);
+};
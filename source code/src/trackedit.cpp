@@ -0,0 +1,139 @@
+#include "trackedit.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include "TrainView.H"
+#include "Track.H"
+
+static glm::vec3 toVec3(const Pnt3f& p) {
+	return glm::vec3(p.x, p.y, p.z);
+}
+
+static Pnt3f toPnt3f(const glm::vec3& v) {
+	return Pnt3f(v.x, v.y, v.z);
+}
+
+TrackEdit::TrackEdit(TrainView* view, unsigned long coalesce) {
+	TrackEdit::view = view;
+	TrackEdit::coalesce = coalesce;
+	TrackEdit::settledNum = 0;
+}
+
+ControlPoint& TrackEdit::change(unsigned int index) {
+	ControlPoint& point = view->m_pTrack->points[index];
+	if (changed.find(index) == changed.end()) {
+		changed[index] = (unsigned int)deltas.size();
+		PointDelta delta;
+		delta.index = index;
+		delta.kind = PointDelta::CHANGE;
+		delta.before = point;
+		deltas.push_back(delta);
+	}
+	return point;
+}
+
+void TrackEdit::settle() {
+	for (unsigned int i = settledNum; i < deltas.size(); i++)
+		if (deltas[i].kind == PointDelta::CHANGE)
+			deltas[i].after = view->m_pTrack->points[deltas[i].index];
+	settledNum = (unsigned int)deltas.size();
+	changed.clear();
+}
+
+void TrackEdit::translate(const std::vector<unsigned int>& points, const glm::vec3& offset) {
+	for (unsigned int i = 0; i < points.size(); i++) {
+		ControlPoint& point = change(points[i]);
+		point.pos = toPnt3f(toVec3(point.pos) + offset);
+	}
+}
+
+void TrackEdit::rotate(const std::vector<unsigned int>& points, float angle, const glm::vec3& axis) {
+	glm::vec3 pivot = center(points);
+	glm::mat4 rotation = glm::rotate(angle, axis);
+	for (unsigned int i = 0; i < points.size(); i++) {
+		ControlPoint& point = change(points[i]);
+		point.pos = toPnt3f(pivot + glm::vec3(rotation * glm::vec4(toVec3(point.pos) - pivot, 0.0f)));
+		point.orient = toPnt3f(glm::vec3(rotation * glm::vec4(toVec3(point.orient), 0.0f)));
+	}
+}
+
+void TrackEdit::scale(const std::vector<unsigned int>& points, float factor) {
+	glm::vec3 pivot = center(points);
+	for (unsigned int i = 0; i < points.size(); i++) {
+		ControlPoint& point = change(points[i]);
+		point.pos = toPnt3f(pivot + (toVec3(point.pos) - pivot) * factor);
+	}
+}
+
+void TrackEdit::roll(const std::vector<unsigned int>& points, float angle, const glm::vec3& axis) {
+	glm::mat4 rotation = glm::rotate(angle, axis);
+	for (unsigned int i = 0; i < points.size(); i++) {
+		ControlPoint& point = change(points[i]);
+		point.orient = toPnt3f(glm::vec3(rotation * glm::vec4(toVec3(point.orient), 0.0f)));
+	}
+}
+
+void TrackEdit::insert(unsigned int index, const ControlPoint& point) {
+	settle();
+	std::vector<ControlPoint>& controlPoints = view->m_pTrack->points;
+	controlPoints.insert(controlPoints.begin() + index, point);
+	PointDelta delta;
+	delta.index = index;
+	delta.kind = PointDelta::INSERT;
+	delta.after = point;
+	deltas.push_back(delta);
+	settledNum = (unsigned int)deltas.size();
+}
+
+void TrackEdit::erase(unsigned int index) {
+	settle();
+	std::vector<ControlPoint>& controlPoints = view->m_pTrack->points;
+	PointDelta delta;
+	delta.index = index;
+	delta.kind = PointDelta::ERASE;
+	delta.before = controlPoints[index];
+	deltas.push_back(delta);
+	settledNum = (unsigned int)deltas.size();
+	controlPoints.erase(controlPoints.begin() + index);
+}
+
+// as if the old points were erased from the back, then the new ones inserted
+void TrackEdit::replaced(const std::vector<ControlPoint>& oldPoints) {
+	settle();
+	const std::vector<ControlPoint>& newPoints = view->m_pTrack->points;
+	PointDelta delta;
+	delta.kind = PointDelta::ERASE;
+	for (unsigned int i = (unsigned int)oldPoints.size(); i > 0; i--) {
+		delta.index = i - 1;
+		delta.before = oldPoints[i - 1];
+		deltas.push_back(delta);
+	}
+	delta.kind = PointDelta::INSERT;
+	for (unsigned int i = 0; i < newPoints.size(); i++) {
+		delta.index = i;
+		delta.after = newPoints[i];
+		deltas.push_back(delta);
+	}
+	settledNum = (unsigned int)deltas.size();
+}
+
+glm::vec3 TrackEdit::center(const std::vector<unsigned int>& points) {
+	glm::vec3 sum(0.0f);
+	if (points.empty()) return sum;
+	for (unsigned int i = 0; i < points.size(); i++)
+		sum += toVec3(view->m_pTrack->points[points[i]].pos);
+	return sum / (float)points.size();
+}
+
+void TrackEdit::commit(bool resetTrain, bool rebuild) {
+	settle();
+	if (deltas.empty()) return;
+	view->journal.record(deltas, coalesce);
+	deltas.clear();
+	settledNum = 0;
+	view->m_pTrack->touch();
+	// the cubes follow right away, the track once it is rebuilt
+	if (rebuild)
+		view->requestTrackSpline(resetTrain);
+	view->redrawScheduler.invalidate();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "editjournal.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <unordered_map>
+
+class TrainView;
+
+// One change to any number of control points, ending in a single track
+// rebuild. The group transforms work on a list of point indices (usually
+// the view's selection) about the center of those points. Nothing is
+// rebuilt until commit(), which asks the track builder for one rebuild
+// and leaves the train where it is; the builder compares the points with
+// its last build and only evaluates the spline segments they reach.
+// The points changed go into the view's journal as one undo step; edits
+// with the same non-zero coalesce key (one mouse drag) share a step.
+class TrackEdit {
+public:
+	TrackEdit(TrainView* view, unsigned long coalesce = 0);
+	// move the points by offset
+	void translate(const std::vector<unsigned int>& points, const glm::vec3& offset);
+	// turn the points about their center, their orientations turn along
+	void rotate(const std::vector<unsigned int>& points, float angle, const glm::vec3& axis);
+	// spread the points out from (or pull them in to) their center
+	void scale(const std::vector<unsigned int>& points, float factor);
+	// turn only the orientations, each point in place
+	void roll(const std::vector<unsigned int>& points, float angle, const glm::vec3& axis);
+	// add a point before index, or take the one at index out
+	void insert(unsigned int index, const ControlPoint& point);
+	void erase(unsigned int index);
+	// the caller put a whole new set of points in, these were there before
+	void replaced(const std::vector<ControlPoint>& oldPoints);
+	// the average position of the points
+	glm::vec3 center(const std::vector<unsigned int>& points);
+	// record the edit, touch the track and queue the rebuild. does nothing
+	// if nothing changed. without rebuild the caller puts the built track
+	// in itself (a baked bundle)
+	void commit(bool resetTrain = false, bool rebuild = true);
+private:
+	// remember a point as it was before its first change
+	ControlPoint& change(unsigned int index);
+	// the changes so far get their after, indices are about to move
+	void settle();
+private:
+	TrainView* view;
+	unsigned long coalesce;
+	std::vector<PointDelta> deltas;
+	std::unordered_map<unsigned int, unsigned int> changed;	// point -> its CHANGE delta since the last settle()
+	unsigned int settledNum;
+};
@@ -0,0 +1,538 @@
+#include "trackgltf.h"
+
+#include "model.h"
+#include "tracksamples.h"
+#include "atomicfile.h"
+#include "mappedfile.h"
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// the points and the vertices go out as they are in memory
+static_assert(sizeof(ControlPoint) == 6 * sizeof(float), "ControlPoint is written as two float triples");
+static_assert(sizeof(MeshVertex) == 6 * sizeof(float), "MeshVertex is written as two float triples");
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 is written as a float triple");
+
+static const uint32_t GLB_MAGIC = 0x46546C67;	// "glTF"
+static const uint32_t GLB_JSON = 0x4E4F534A;	// "JSON"
+static const uint32_t GLB_BIN = 0x004E4942;		// "BIN\0"
+enum {
+	GL_FLOAT_TYPE = 5126,
+	GL_UNSIGNED_INT_TYPE = 5125,
+	GL_ARRAY_BUFFER_TARGET = 34962,
+	GL_ELEMENT_ARRAY_BUFFER_TARGET = 34963,
+	GLTF_POINTS = 0,
+	GLTF_LINE_LOOP = 2,
+};
+
+//************************************************************************
+//
+// * Writing
+//========================================================================
+// what a part of the binary chunk is made of
+enum {
+	PIECE_MEMORY,			// written as it is
+	PIECE_SAMPLE_POSITIONS,	// decoded from the track
+	PIECE_SAMPLE_TANGENTS,
+	PIECE_SAMPLE_UPS,
+	PIECE_SAMPLE_CROSSES,
+	PIECE_QUAD_TRIANGLES,	// two triangles for every quad of data
+};
+
+struct GlbPiece {
+	int kind;
+	const void* data;	// PIECE_MEMORY and the quad indices
+	size_t size;
+};
+
+static void appendf(std::string& text, const char* format, ...) {
+	char buf[256];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	if (length > 0) text.append(buf, (size_t)length < sizeof(buf) ? (size_t)length : sizeof(buf) - 1);
+}
+
+// a new entry of a JSON array kept as text
+static std::string& addItem(std::string& list) {
+	if (!list.empty()) list += ',';
+	return list;
+}
+
+static void appendVec3(std::string& text, const glm::vec3& v) {
+	appendf(text, "[%.9g,%.9g,%.9g]", v.x, v.y, v.z);
+}
+
+// the JSON and the layout of the binary chunk, built up before anything
+// is written since the header needs every length
+class GlbWriter {
+public:
+	std::string nodes, sceneNodes, meshes, materials, accessors, views;
+	std::vector<GlbPiece> pieces;
+	size_t binSize;
+	unsigned int nodeNum, meshNum, materialNum, accessorNum, viewNum;
+public:
+	GlbWriter() : binSize(0), nodeNum(0), meshNum(0), materialNum(0), accessorNum(0), viewNum(0) {}
+	unsigned int addView(int kind, const void* data, size_t size, unsigned int stride, int target) {
+		GlbPiece piece;
+		piece.kind = kind;
+		piece.data = data;
+		piece.size = size;
+		pieces.push_back(piece);
+		appendf(addItem(views), "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu", binSize, size);
+		if (stride) appendf(views, ",\"byteStride\":%u", stride);
+		if (target) appendf(views, ",\"target\":%d", target);
+		views += '}';
+		binSize += (size + 3) & ~(size_t)3;
+		return viewNum++;
+	}
+	unsigned int addAccessor(unsigned int view, size_t offset, int componentType, size_t count, const char* type,
+		const glm::vec3* boundsMin = NULL, const glm::vec3* boundsMax = NULL) {
+		appendf(addItem(accessors), "{\"bufferView\":%u,\"byteOffset\":%zu,\"componentType\":%d,\"count\":%zu,\"type\":\"%s\"",
+			view, offset, componentType, count, type);
+		if (boundsMin && boundsMax) {
+			accessors += ",\"min\":";
+			appendVec3(accessors, *boundsMin);
+			accessors += ",\"max\":";
+			appendVec3(accessors, *boundsMax);
+		}
+		accessors += '}';
+		return accessorNum++;
+	}
+	unsigned int addNode(const char* name, int mesh, const glm::mat4* matrix, const std::string& children) {
+		appendf(addItem(nodes), "{\"name\":\"%s\"", name);
+		if (mesh >= 0) appendf(nodes, ",\"mesh\":%d", mesh);
+		if (matrix) {
+			const float* m = &(*matrix)[0][0];
+			nodes += ",\"matrix\":[";
+			for (int i = 0; i < 16; i++) appendf(nodes, i ? ",%.9g" : "%.9g", m[i]);
+			nodes += ']';
+		}
+		if (!children.empty()) nodes += ",\"children\":[" + children + "]";
+		nodes += '}';
+		return nodeNum++;
+	}
+	void addSceneNode(unsigned int node) {
+		appendf(addItem(sceneNodes), "%u", node);
+	}
+	void addPart(const GltfPart& part);
+	void addSamples(const TrackData& track, bool frames, std::string& extras);
+	bool write(FILE* fp, const std::string& json, const TrackData* track);
+};
+
+void GlbWriter::addPart(const GltfPart& part) {
+	const ModelClass* model = part.model;
+	if (model == NULL || !model->mesh || model->transforms.empty()) return;
+	const MeshData& mesh = *model->mesh;
+	if (mesh.vertexNum == 0 || mesh.indexNum == 0) return;
+
+	// one vertex buffer for both attributes, one index buffer for every
+	// range. quads become triangles 0 1 2 and 0 2 3, so a range of n quad
+	// indices is n / 4 * 6 triangle indices
+	bool quads = part.mode == GltfPart::QUADS;
+	size_t indexNum = quads ? mesh.indexNum / 4 * 6 : mesh.indexNum;
+	unsigned int vertexView = addView(PIECE_MEMORY, mesh.vertices, mesh.vertexNum * sizeof(MeshVertex), sizeof(MeshVertex), GL_ARRAY_BUFFER_TARGET);
+	unsigned int indexView = addView(quads ? PIECE_QUAD_TRIANGLES : PIECE_MEMORY, mesh.indices,
+		indexNum * sizeof(unsigned int), 0, GL_ELEMENT_ARRAY_BUFFER_TARGET);
+	unsigned int positionAccessor = addAccessor(vertexView, 0, GL_FLOAT_TYPE, mesh.vertexNum, "VEC3", &mesh.boundsMin, &mesh.boundsMax);
+	unsigned int normalAccessor = addAccessor(vertexView, sizeof(glm::vec3), GL_FLOAT_TYPE, mesh.vertexNum, "VEC3");
+
+	std::string primitives;
+	for (unsigned int meshIdx = 0; meshIdx < mesh.meshes.size(); meshIdx++) {
+		const Mesh& range = mesh.meshes[meshIdx];
+		size_t firstIndex = quads ? range.firstIndex / 4 * 6 : range.firstIndex;
+		size_t rangeNum = quads ? range.indexNum / 4 * 6 : range.indexNum;
+		if (rangeNum == 0) continue;
+		unsigned int indexAccessor = addAccessor(indexView, firstIndex * sizeof(unsigned int), GL_UNSIGNED_INT_TYPE, rangeNum, "SCALAR");
+		glm::u8vec3 color = (meshIdx < model->colors.size()) ? model->colors[meshIdx] : model->baseColor;
+		appendf(addItem(materials), "{\"pbrMetallicRoughness\":{\"baseColorFactor\":[%.4g,%.4g,%.4g,1],\"metallicFactor\":0}}",
+			color.x / 255.0f, color.y / 255.0f, color.z / 255.0f);
+		appendf(addItem(primitives), "{\"attributes\":{\"POSITION\":%u,\"NORMAL\":%u},\"indices\":%u,\"material\":%u}",
+			positionAccessor, normalAccessor, indexAccessor, materialNum++);
+	}
+	if (primitives.empty()) return;
+	appendf(addItem(meshes), "{\"name\":\"%s\",\"primitives\":[", part.name);
+	meshes += primitives + "]}";
+	int meshIdx = (int)meshNum++;
+
+	// an instanced model is a node holding one node per instance
+	if (model->transforms.size() == 1) {
+		addSceneNode(addNode(part.name, meshIdx, &model->transforms[0], std::string()));
+		return;
+	}
+	std::string children;
+	for (unsigned int instanceIdx = 0; instanceIdx < model->transforms.size(); instanceIdx++)
+		appendf(addItem(children), "%u", addNode(part.name, meshIdx, &model->transforms[instanceIdx], std::string()));
+	addSceneNode(addNode(part.name, -1, NULL, children));
+}
+
+void GlbWriter::addSamples(const TrackData& track, bool frames, std::string& extras) {
+	unsigned int sampleNum = track.size();
+	size_t vec3Size = sampleNum * sizeof(glm::vec3);
+
+	// POSITION needs its bounds in the JSON, so the positions are decoded
+	// once for them before they are written
+	glm::vec3 boundsMin = track.position(0), boundsMax = boundsMin;
+	for (unsigned int i = 1; i < sampleNum; i++) {
+		glm::vec3 pos = track.position(i);
+		boundsMin = glm::min(boundsMin, pos);
+		boundsMax = glm::max(boundsMax, pos);
+	}
+	unsigned int positions = addAccessor(addView(PIECE_SAMPLE_POSITIONS, NULL, vec3Size, 0, GL_ARRAY_BUFFER_TARGET),
+		0, GL_FLOAT_TYPE, sampleNum, "VEC3", &boundsMin, &boundsMax);
+	appendf(addItem(meshes), "{\"name\":\"centerline\",\"primitives\":[{\"attributes\":{\"POSITION\":%u},\"mode\":%d}]}",
+		positions, GLTF_LINE_LOOP);
+	addSceneNode(addNode("centerline", (int)meshNum++, NULL, std::string()));
+	appendf(addItem(extras), "\"samples\":{\"positions\":%u", positions);
+
+	if (frames) {
+		const std::vector<float>& lengths = track.lengths();
+		unsigned int lengthAccessor = addAccessor(addView(PIECE_MEMORY, &lengths[0], lengths.size() * sizeof(float), 0, 0),
+			0, GL_FLOAT_TYPE, lengths.size(), "SCALAR");
+		unsigned int tangents = addAccessor(addView(PIECE_SAMPLE_TANGENTS, NULL, vec3Size, 0, 0), 0, GL_FLOAT_TYPE, sampleNum, "VEC3");
+		unsigned int ups = addAccessor(addView(PIECE_SAMPLE_UPS, NULL, vec3Size, 0, 0), 0, GL_FLOAT_TYPE, sampleNum, "VEC3");
+		unsigned int crosses = addAccessor(addView(PIECE_SAMPLE_CROSSES, NULL, vec3Size, 0, 0), 0, GL_FLOAT_TYPE, sampleNum, "VEC3");
+		appendf(extras, ",\"lengths\":%u,\"tangents\":%u,\"ups\":%u,\"crosses\":%u", lengthAccessor, tangents, ups, crosses);
+	}
+	extras += '}';
+}
+
+// a vector of every sample, the same frame TrackSweep hands out
+static glm::vec3 sampleVector(const TrackData& track, unsigned int idx, int kind) {
+	switch (kind) {
+	case PIECE_SAMPLE_POSITIONS: return track.position(idx);
+	case PIECE_SAMPLE_TANGENTS: return track.tangent(idx);
+	case PIECE_SAMPLE_UPS: return track.up(idx);
+	default: return track.cross(idx);
+	}
+}
+
+bool GlbWriter::write(FILE* fp, const std::string& json, const TrackData* track) {
+	static const unsigned char padding[4] = { 0, 0, 0, 0 };
+	uint32_t jsonSize = (uint32_t)((json.size() + 3) & ~(size_t)3);
+	uint32_t header[3] = { GLB_MAGIC, 2, (uint32_t)(12 + 8 + jsonSize + 8 + binSize) };
+	uint32_t jsonChunk[2] = { jsonSize, GLB_JSON };
+	uint32_t binChunk[2] = { (uint32_t)binSize, GLB_BIN };
+	bool ok = fwrite(header, sizeof(header), 1, fp) == 1 && fwrite(jsonChunk, sizeof(jsonChunk), 1, fp) == 1;
+	// the JSON chunk is padded with spaces
+	ok = ok && fwrite(json.data(), 1, json.size(), fp) == json.size() && fwrite("   ", 1, jsonSize - json.size(), fp) == jsonSize - json.size();
+	ok = ok && fwrite(binChunk, sizeof(binChunk), 1, fp) == 1;
+
+	glm::vec3 batch[1024];
+	uint32_t triangles[1536];
+	for (size_t pieceIdx = 0; ok && pieceIdx < pieces.size(); pieceIdx++) {
+		const GlbPiece& piece = pieces[pieceIdx];
+		if (piece.kind == PIECE_MEMORY)
+			ok = fwrite(piece.data, 1, piece.size, fp) == piece.size;
+		else if (piece.kind == PIECE_QUAD_TRIANGLES) {
+			const unsigned int* quad = (const unsigned int*)piece.data;
+			size_t quadNum = piece.size / (6 * sizeof(uint32_t));
+			for (size_t begin = 0; ok && begin < quadNum; begin += 256) {
+				size_t count = (quadNum - begin < 256) ? quadNum - begin : 256;
+				for (size_t i = 0; i < count; i++, quad += 4) {
+					uint32_t* triangle = triangles + 6 * i;
+					triangle[0] = quad[0]; triangle[1] = quad[1]; triangle[2] = quad[2];
+					triangle[3] = quad[0]; triangle[4] = quad[2]; triangle[5] = quad[3];
+				}
+				ok = fwrite(triangles, 6 * sizeof(uint32_t), count, fp) == count;
+			}
+		}
+		else {
+			unsigned int sampleNum = track->size();
+			for (unsigned int begin = 0; ok && begin < sampleNum; begin += 1024) {
+				unsigned int count = (sampleNum - begin < 1024) ? sampleNum - begin : 1024;
+				for (unsigned int i = 0; i < count; i++)
+					batch[i] = sampleVector(*track, begin + i, piece.kind);
+				ok = fwrite(batch, sizeof(glm::vec3), count, fp) == count;
+			}
+		}
+		size_t pad = ((piece.size + 3) & ~(size_t)3) - piece.size;
+		ok = ok && fwrite(padding, 1, pad, fp) == pad;
+	}
+	return ok;
+}
+
+bool TrackGltf::write(const char* fileName, const std::vector<ControlPoint>& points, const TrackData* track,
+	bool frames, const std::vector<GltfPart>& parts) {
+	GlbWriter writer;
+	std::string extras;
+
+	// the control points are a mesh of points too, the orientation as a
+	// custom attribute, so other tools can show them
+	if (!points.empty()) {
+		glm::vec3 boundsMin(points[0].pos.x, points[0].pos.y, points[0].pos.z), boundsMax = boundsMin;
+		for (size_t i = 1; i < points.size(); i++) {
+			glm::vec3 pos(points[i].pos.x, points[i].pos.y, points[i].pos.z);
+			boundsMin = glm::min(boundsMin, pos);
+			boundsMax = glm::max(boundsMax, pos);
+		}
+		unsigned int pointView = writer.addView(PIECE_MEMORY, &points[0], points.size() * sizeof(ControlPoint), sizeof(ControlPoint), GL_ARRAY_BUFFER_TARGET);
+		unsigned int positions = writer.addAccessor(pointView, 0, GL_FLOAT_TYPE, points.size(), "VEC3", &boundsMin, &boundsMax);
+		unsigned int orients = writer.addAccessor(pointView, sizeof(Pnt3f), GL_FLOAT_TYPE, points.size(), "VEC3");
+		appendf(addItem(writer.meshes), "{\"name\":\"controlPoints\",\"primitives\":[{\"attributes\":{\"POSITION\":%u,\"_ORIENT\":%u},\"mode\":%d}]}",
+			positions, orients, GLTF_POINTS);
+		writer.addSceneNode(writer.addNode("controlPoints", (int)writer.meshNum++, NULL, std::string()));
+		appendf(addItem(extras), "\"controlPoints\":{\"positions\":%u,\"orients\":%u}", positions, orients);
+	}
+	if (track != NULL && !track->empty())
+		writer.addSamples(*track, frames, extras);
+	for (size_t partIdx = 0; partIdx < parts.size(); partIdx++)
+		writer.addPart(parts[partIdx]);
+
+	std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"RollerCoasters\"}";
+	if (!writer.sceneNodes.empty()) json += ",\"scene\":0,\"scenes\":[{\"nodes\":[" + writer.sceneNodes + "]}]";
+	if (!writer.nodes.empty()) json += ",\"nodes\":[" + writer.nodes + "]";
+	if (!writer.meshes.empty()) json += ",\"meshes\":[" + writer.meshes + "]";
+	if (!writer.materials.empty()) json += ",\"materials\":[" + writer.materials + "]";
+	if (!writer.accessors.empty()) json += ",\"accessors\":[" + writer.accessors + "]";
+	if (!writer.views.empty()) json += ",\"bufferViews\":[" + writer.views + "]";
+	appendf(json, ",\"buffers\":[{\"byteLength\":%zu}]", writer.binSize);
+	if (!extras.empty()) json += ",\"extras\":{" + extras + "}";
+	json += '}';
+
+	AtomicFile file;
+	if (!file.open(fileName, true)) return false;
+	if (!writer.write(file.stream(), json, track)) {
+		file.abandon();
+		return false;
+	}
+	return file.commit();
+}
+
+//************************************************************************
+//
+// * Reading
+//========================================================================
+// just enough JSON to find our way through a glTF file
+struct JsonValue {
+	enum Type { NONE, LITERAL, NUMBER, STRING, ARRAY, OBJECT };
+	Type type;
+	double number;
+	std::string text;
+	std::vector<std::string> keys;	// an object's, one per item
+	std::vector<JsonValue> items;
+	JsonValue() : type(NONE), number(0) {}
+	const JsonValue* get(const char* key) const {
+		for (size_t i = 0; i < keys.size(); i++)
+			if (keys[i] == key) return &items[i];
+		return NULL;
+	}
+	const JsonValue* at(double idx) const {
+		if (type != ARRAY || idx < 0 || idx >= items.size() || idx != (double)(size_t)idx) return NULL;
+		return &items[(size_t)idx];
+	}
+};
+
+class JsonReader {
+public:
+	JsonReader(const char* text, size_t length) : p(text), end(text + length) {}
+	bool parse(JsonValue& value) {
+		return parseValue(value, 0) && (skipSpaces(), p == end);
+	}
+private:
+	void skipSpaces() {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+	}
+	bool parseString(std::string& text) {
+		if (p >= end || *p != '"') return false;
+		p++;
+		while (p < end && *p != '"') {
+			char c = *p++;
+			if (c == '\\') {
+				if (p >= end) return false;
+				c = *p++;
+				switch (c) {
+				case 'b': c = '\b'; break;
+				case 'f': c = '\f'; break;
+				case 'n': c = '\n'; break;
+				case 'r': c = '\r'; break;
+				case 't': c = '\t'; break;
+				case 'u':
+					// no names we look for need them
+					if (end - p < 4) return false;
+					p += 4;
+					c = '?';
+					break;
+				}
+			}
+			text += c;
+		}
+		if (p >= end) return false;
+		p++;
+		return true;
+	}
+	bool parseValue(JsonValue& value, int depth) {
+		skipSpaces();
+		if (p >= end || depth > 64) return false;
+		if (*p == '{' || *p == '[') {
+			bool object = (*p == '{');
+			char close = object ? '}' : ']';
+			value.type = object ? JsonValue::OBJECT : JsonValue::ARRAY;
+			p++;
+			skipSpaces();
+			if (p < end && *p == close) {
+				p++;
+				return true;
+			}
+			for (;;) {
+				if (object) {
+					skipSpaces();
+					value.keys.push_back(std::string());
+					if (!parseString(value.keys.back())) return false;
+					skipSpaces();
+					if (p >= end || *p++ != ':') return false;
+				}
+				value.items.push_back(JsonValue());
+				if (!parseValue(value.items.back(), depth + 1)) return false;
+				skipSpaces();
+				if (p >= end) return false;
+				if (*p == close) {
+					p++;
+					return true;
+				}
+				if (*p++ != ',') return false;
+			}
+		}
+		if (*p == '"') {
+			value.type = JsonValue::STRING;
+			return parseString(value.text);
+		}
+		const char* start = p;
+		while (p < end && (isalnum((unsigned char)*p) || *p == '-' || *p == '+' || *p == '.')) p++;
+		if (p == start) return false;
+		std::string word(start, p);
+		if (word == "true" || word == "false" || word == "null") {
+			value.type = JsonValue::LITERAL;
+			value.text = word;
+			return true;
+		}
+		char* wordEnd;
+		value.number = strtod(word.c_str(), &wordEnd);
+		value.type = JsonValue::NUMBER;
+		return *wordEnd == 0;
+	}
+private:
+	const char* p;
+	const char* end;
+};
+
+static double numberOr(const JsonValue* value, double fallback) {
+	return (value != NULL && value->type == JsonValue::NUMBER) ? value->number : fallback;
+}
+
+// the float triples of an accessor, checked against the binary chunk.
+// each one is handed to store with its index
+template <class Store>
+static bool readVec3(const JsonValue& root, const JsonValue* accessorIdx, const unsigned char* bin, size_t binSize,
+	size_t& count, Store store, std::string& why) {
+	const JsonValue* accessors = root.get("accessors");
+	const JsonValue* accessor = (accessors && accessorIdx) ? accessors->at(numberOr(accessorIdx, -1)) : NULL;
+	if (accessor == NULL) {
+		why = "a control point accessor is missing";
+		return false;
+	}
+	const JsonValue* type = accessor->get("type");
+	if (numberOr(accessor->get("componentType"), 0) != GL_FLOAT_TYPE || type == NULL || type->text != "VEC3") {
+		why = "control points must be float VEC3 accessors";
+		return false;
+	}
+	const JsonValue* views = root.get("bufferViews");
+	const JsonValue* view = views ? views->at(numberOr(accessor->get("bufferView"), -1)) : NULL;
+	if (view == NULL || numberOr(view->get("buffer"), 0) != 0) {
+		why = "control points must be in the file's binary chunk";
+		return false;
+	}
+	double countValue = numberOr(accessor->get("count"), 0);
+	double offset = numberOr(view->get("byteOffset"), 0) + numberOr(accessor->get("byteOffset"), 0);
+	double viewEnd = numberOr(view->get("byteOffset"), 0) + numberOr(view->get("byteLength"), 0);
+	double stride = numberOr(view->get("byteStride"), sizeof(glm::vec3));
+	if (countValue < 1 || stride < sizeof(glm::vec3) || viewEnd > binSize
+		|| offset + (countValue - 1) * stride + sizeof(glm::vec3) > viewEnd) {
+		why = "a control point accessor reaches past its buffer";
+		return false;
+	}
+	count = (size_t)countValue;
+	for (size_t i = 0; i < count; i++) {
+		float v[3];
+		memcpy(v, bin + (size_t)offset + i * (size_t)stride, sizeof(v));
+		store(i, Pnt3f(v[0], v[1], v[2]));
+	}
+	return true;
+}
+
+bool TrackGltf::read(const char* fileName, std::vector<ControlPoint>& points, TrackParseError& error) {
+	error.line = 0;
+	error.column = 0;
+	MappedFile file;
+	if (!file.open(fileName)) {
+		error.message = "can't open the file";
+		return false;
+	}
+	const unsigned char* data = file.data();
+	size_t size = file.size();
+
+	// the header, the JSON chunk, then the binary one
+	uint32_t header[5];
+	if (size < sizeof(header)) {
+		error.message = "not a binary glTF file";
+		return false;
+	}
+	memcpy(header, data, sizeof(header));
+	if (header[0] != GLB_MAGIC || header[1] != 2 || header[4] != GLB_JSON || header[2] > size || header[3] > size - sizeof(header)) {
+		error.message = "not a binary glTF 2.0 file";
+		return false;
+	}
+	const char* json = (const char*)data + sizeof(header);
+	size_t jsonSize = header[3];
+	const unsigned char* bin = NULL;
+	size_t binSize = 0;
+	size_t binAt = sizeof(header) + jsonSize;
+	uint32_t binChunk[2];
+	if (size - binAt >= sizeof(binChunk)) {
+		memcpy(binChunk, data + binAt, sizeof(binChunk));
+		if (binChunk[1] == GLB_BIN && binChunk[0] <= size - binAt - sizeof(binChunk)) {
+			bin = data + binAt + sizeof(binChunk);
+			binSize = binChunk[0];
+		}
+	}
+
+	JsonValue root;
+	JsonReader reader(json, jsonSize);
+	if (!reader.parse(root) || root.type != JsonValue::OBJECT) {
+		error.message = "the glTF JSON is malformed";
+		return false;
+	}
+	const JsonValue* extras = root.get("extras");
+	const JsonValue* controlPoints = extras ? extras->get("controlPoints") : NULL;
+	if (controlPoints == NULL) {
+		error.message = "the file has no control points (it wasn't exported from a track)";
+		return false;
+	}
+
+	std::vector<ControlPoint> loaded;
+	size_t count = 0;
+	if (!readVec3(root, controlPoints->get("positions"), bin, binSize, count,
+		[&loaded](size_t, const Pnt3f& pos) { loaded.push_back(ControlPoint(pos)); }, error.message))
+		return false;
+	if (count < 4) {
+		error.message = "a track needs at least 4 points";
+		return false;
+	}
+	const JsonValue* orients = controlPoints->get("orients");
+	if (orients != NULL) {
+		size_t orientNum = 0;
+		if (!readVec3(root, orients, bin, binSize, orientNum,
+			[&loaded](size_t i, const Pnt3f& orient) { if (i < loaded.size()) loaded[i].orient = orient; }, error.message))
+			return false;
+	}
+	for (size_t i = 0; i < loaded.size(); i++)
+		loaded[i].orient.normalize();
+	points.swap(loaded);
+	return true;
+}
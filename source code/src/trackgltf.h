@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ControlPoint.H"
+#include "trackparser.h"
+
+#include <vector>
+
+class ModelClass;
+class TrackData;
+
+// a model written to a glTF file, one node per instance transform. mode
+// is how its indices are drawn; glTF has no quads, so a quad model is
+// written as two triangles per quad
+struct GltfPart {
+	enum Mode { TRIANGLES, QUADS };
+	const char* name;
+	const ModelClass* model;
+	Mode mode;
+	GltfPart(const char* name, const ModelClass* model, Mode mode = TRIANGLES) : name(name), model(model), mode(mode) {}
+};
+
+// Tracks as binary glTF 2.0 (.glb), for tools that know nothing of our
+// text format. The control points go in as two accessors named in the
+// file's extras, so reading the file back gives the same layout; the
+// samples are the center line, drawn as a line loop, and each part is a
+// mesh with its colors. With frames the samples' running lengths and
+// their frames (tangent, up and cross) are added to the extras too, so a
+// tool can use the track as we sample it instead of sampling it again.
+// Everything in the binary chunk is written straight from where it lives
+// (the points, the mesh buffers, the lengths); only what TrackData keeps
+// packed is decoded and the triangles of quad meshes are made from their
+// indices, a small batch at a time.
+class TrackGltf {
+public:
+	// any of track and the parts' models may be NULL or empty, they are left out
+	static bool write(const char* fileName, const std::vector<ControlPoint>& points, const TrackData* track,
+		bool frames, const std::vector<GltfPart>& parts);
+	// only the control points are read, the rest is built from them again.
+	// on failure points is left as it was
+	static bool read(const char* fileName, std::vector<ControlPoint>& points, TrackParseError& error);
+};
@@ -0,0 +1,164 @@
+#include "trackparser.h"
+
+#include <charconv>
+#include <algorithm>
+#include <stdio.h>
+
+// a position in the text being parsed
+struct TextCursor {
+	const char* p;
+	const char* end;
+	const char* lineStart;
+	unsigned int line;
+};
+
+static void fail(TrackParseError& error, const TextCursor& at, const char* where, const std::string& message) {
+	error.line = at.line;
+	error.column = (unsigned int)(where - at.lineStart) + 1;
+	error.message = message;
+}
+
+// skips spaces and a comment, stops at the end of the line
+static void skipBlanks(TextCursor& at) {
+	while (at.p < at.end && *at.p != '\n' && *at.p <= ' ') at.p++;
+	if (at.p < at.end && *at.p == '#')
+		while (at.p < at.end && *at.p != '\n') at.p++;
+}
+
+static bool atLineEnd(const TextCursor& at) {
+	return at.p >= at.end || *at.p == '\n';
+}
+
+// past the end of the line to the start of the next one
+static void nextLine(TextCursor& at) {
+	while (at.p < at.end && *at.p != '\n') at.p++;
+	if (at.p < at.end) at.p++;
+	at.lineStart = at.p;
+	at.line++;
+}
+
+// skips lines with nothing but spaces and comments, false at the end of the text
+static bool nextContent(TextCursor& at) {
+	for (;;) {
+		skipBlanks(at);
+		if (!atLineEnd(at)) return true;
+		if (at.p >= at.end) return false;
+		nextLine(at);
+	}
+}
+
+// one whole word as a number, strtod took a leading '+' so it is allowed too
+template <class T>
+static bool readNumber(TextCursor& at, T& value) {
+	const char* first = at.p;
+	if (first < at.end && *first == '+') first++;
+	std::from_chars_result result = std::from_chars(first, at.end, value);
+	if (result.ec != std::errc() || (result.ptr < at.end && *result.ptr > ' ' && *result.ptr != '#'))
+		return false;
+	at.p = result.ptr;
+	return true;
+}
+
+TrackParser::TrackParser() {
+}
+
+bool TrackParser::read(const char* fileName, std::vector<ControlPoint>& points, TrackParseError& error) {
+	error.line = 0;
+	error.column = 0;
+	FILE* fp = fopen(fileName, "rb");
+	if (!fp) {
+		error.message = "can't open the file";
+		return false;
+	}
+	long length = -1;
+	if (fseek(fp, 0, SEEK_END) == 0) length = ftell(fp);
+	if (length < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+		fclose(fp);
+		error.message = "can't read the file";
+		return false;
+	}
+	TrackParser::text.resize((size_t)length);
+	size_t got = (length > 0) ? fread(text.data(), 1, (size_t)length, fp) : 0;
+	fclose(fp);
+	if (got != (size_t)length) {
+		error.message = "can't read the file";
+		return false;
+	}
+	return parse(text.data(), text.size(), points, error);
+}
+
+bool TrackParser::parse(const char* text, size_t length, std::vector<ControlPoint>& points, TrackParseError& error) {
+	TextCursor at;
+	at.p = text;
+	at.end = text + length;
+	at.lineStart = text;
+	at.line = 1;
+
+	// first the number of points
+	size_t pointNum = 0;
+	if (!nextContent(at)) {
+		fail(error, at, at.p, "the file is empty");
+		return false;
+	}
+	const char* countAt = at.p;
+	if (!readNumber(at, pointNum)) {
+		fail(error, at, countAt, "expected the number of points");
+		return false;
+	}
+	skipBlanks(at);
+	if (!atLineEnd(at)) {
+		fail(error, at, at.p, "expected only the number of points on the line");
+		return false;
+	}
+	if (pointNum < 4) {
+		fail(error, at, countAt, "a track needs at least 4 points");
+		return false;
+	}
+	nextLine(at);
+
+	// a file can't hold more points than it has lines, a wrong count
+	// shouldn't reserve more than that
+	size_t lineNum = 0;
+	for (const char* p = at.p; p < at.end; p++)
+		if (*p == '\n') lineNum++;
+	TrackParser::parsed.clear();
+	parsed.reserve(std::min(pointNum, lineNum + 1));
+
+	// then one point per line until there are enough; the files always
+	// could end early, what is there is the track
+	float values[6];
+	while (parsed.size() < pointNum && nextContent(at)) {
+		unsigned int valueNum = 0;
+		while (!atLineEnd(at)) {
+			if (valueNum == 6) {
+				fail(error, at, at.p, "expected 3 or 6 numbers, found more");
+				return false;
+			}
+			const char* valueAt = at.p;
+			if (!readNumber(at, values[valueNum])) {
+				fail(error, at, valueAt, "expected a number");
+				return false;
+			}
+			valueNum++;
+			skipBlanks(at);
+		}
+		if (valueNum != 3 && valueNum != 6) {
+			fail(error, at, at.p, "expected 3 or 6 numbers, found " + std::to_string(valueNum));
+			return false;
+		}
+		Pnt3f pos(values[0], values[1], values[2]);
+		Pnt3f orient(0, 1, 0);
+		if (valueNum == 6) orient = Pnt3f(values[3], values[4], values[5]);
+		orient.normalize();
+		parsed.push_back(ControlPoint(pos, orient));
+		nextLine(at);
+	}
+	if (parsed.size() < 4) {
+		fail(error, at, at.p, "a track needs at least 4 points, found " + std::to_string(parsed.size()));
+		return false;
+	}
+
+	// the old points' storage is kept for the next file
+	points.swap(parsed);
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ControlPoint.H"
+
+#include <vector>
+#include <string>
+
+// where and why a track file could not be read
+struct TrackParseError {
+	unsigned int line;		// counted from 1, 0 when the file couldn't be read at all
+	unsigned int column;	// counted from 1
+	std::string message;
+};
+
+// Reads the text track format: the number of points, then one point per
+// line, either x y z or x y z and the orientation. '#' starts a comment.
+// The whole file comes in with one read and the numbers are converted in
+// place with from_chars; the buffers are kept for the next file, so loading
+// tracks one after another doesn't allocate once they're large enough.
+// Malformed input is reported with its line and column, it is never
+// replaced by zeros.
+class TrackParser {
+public:
+	TrackParser();
+	// on failure points is left as it was
+	bool read(const char* fileName, std::vector<ControlPoint>& points, TrackParseError& error);
+	bool parse(const char* text, size_t length, std::vector<ControlPoint>& points, TrackParseError& error);
+private:
+	std::vector<char> text;
+	std::vector<ControlPoint> parsed;
+private:
+	TrackParser(const TrackParser&);
+	TrackParser& operator=(const TrackParser&);
+};
@@ -0,0 +1,75 @@
+#include "trackplacement.h"
+
+#include <algorithm>
+#include <math.h>
+
+TrackSweep::TrackSweep(const TrackData& track, float spacing) : track(track) {
+	TrackSweep::spotNum = 0;
+	if (spacing > 0.0f && !track.empty())
+		TrackSweep::spotNum = (unsigned int)(track.trackLength() / spacing);
+	TrackSweep::step = (spotNum > 0) ? track.trackLength() / (float)spotNum : 0.0f;
+	TrackSweep::spotIdx = 0;
+	TrackSweep::spotEnd = spotNum;
+	TrackSweep::segmentIdx = 0;
+}
+
+TrackSweep::TrackSweep(const TrackData& track, float spacing, float begin, float end) : TrackSweep(track, spacing) {
+	if (spotNum == 0) return;
+	// the first spot at or after each end
+	float first = ceilf(begin / step), last = ceilf(end / step);
+	TrackSweep::spotIdx = (unsigned int)fminf(fmaxf(first, 0.0f), (float)spotNum);
+	TrackSweep::spotEnd = (unsigned int)fminf(fmaxf(last, (float)spotIdx), (float)spotNum);
+	// start the walk at the sample holding the first spot
+	const std::vector<float>& lengths = track.lengths();
+	TrackSweep::segmentIdx = (unsigned int)(std::lower_bound(lengths.begin(), lengths.end(), spotIdx * step) - lengths.begin());
+	if (segmentIdx >= lengths.size()) segmentIdx = (unsigned int)lengths.size() - 1;
+}
+
+unsigned int TrackSweep::count() {
+	return spotEnd - spotIdx;
+}
+
+bool TrackSweep::next(TrackSpot& spot) {
+	if (spotIdx >= spotEnd) return false;
+	float target = spotIdx * step;
+	spot.index = spotIdx;
+	spotIdx++;
+
+	// the first sample ending at or past the target holds it
+	const std::vector<float>& lengths = track.lengths();
+	unsigned int sampleNum = (unsigned int)lengths.size();
+	while (segmentIdx + 1 < sampleNum && lengths[segmentIdx] < target)
+		segmentIdx++;
+	float begin = (segmentIdx == 0) ? 0.0f : lengths[segmentIdx - 1];
+	float segmentLength = lengths[segmentIdx] - begin;
+	float t = (segmentLength > 0.0f) ? (target - begin) / segmentLength : 0.0f;
+	unsigned int nextIdx = (segmentIdx + 1) % sampleNum;
+
+	glm::vec3 begPos = track.position(segmentIdx);
+	glm::vec3 endPos = track.position(nextIdx);
+	glm::vec3 cross = (1 - t) * track.cross(segmentIdx) + t * track.cross(nextIdx);
+	spot.position = (1 - t) * begPos + t * endPos;
+	spot.forward = track.tangentAt(segmentIdx, target - begin);
+	spot.up = glm::normalize(-glm::cross(spot.forward, cross));
+	spot.side = glm::normalize(glm::cross(spot.forward, spot.up));
+	spot.distance = target;
+	return true;
+}
+
+glm::mat4 spotTransform(const TrackSpot& spot, float scale) {
+	// translate * rotate * scale, written out as columns
+	return glm::mat4(
+		glm::vec4(spot.side * scale, 0.0f),
+		glm::vec4(spot.up * scale, 0.0f),
+		glm::vec4(spot.forward * scale, 0.0f),
+		glm::vec4(spot.position, 1.0f));
+}
+
+unsigned int placeAlongTrack(const TrackData& track, float spacing, float scale, std::vector<glm::mat4>& transforms) {
+	TrackSweep sweep(track, spacing);
+	transforms.resize(sweep.count());
+	TrackSpot spot;
+	for (unsigned int i = 0; sweep.next(spot); i++)
+		transforms[i] = spotTransform(spot, scale);
+	return (unsigned int)transforms.size();
+}
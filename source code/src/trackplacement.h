@@ -0,0 +1,49 @@
+#pragma once
+
+#include "trackbuilder.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// a place on the track handed out by TrackSweep, with the track's frame there
+struct TrackSpot {
+	glm::vec3 position;
+	glm::vec3 forward;	// along the track
+	glm::vec3 up;		// away from the rails' plane
+	glm::vec3 side;
+	float distance;		// arc length from the start
+	unsigned int index;	// counted from the start of the track
+};
+
+// Walks the running length table of a track once from the start, handing
+// out a spot every spacing units. The spacing is stretched a little so the
+// spots come out even around the loop. Each next() only moves forward, so a
+// whole sweep costs one pass over the samples however many spots it gives.
+// A sweep can be limited to the spots from begin up to (not including) end,
+// they are the same spots a whole sweep gives there.
+class TrackSweep {
+public:
+	TrackSweep(const TrackData& track, float spacing);
+	TrackSweep(const TrackData& track, float spacing, float begin, float end);
+	// how many spots the sweep has left to give
+	unsigned int count();
+	// false once every spot was given
+	bool next(TrackSpot& spot);
+private:
+	const TrackData& track;
+	unsigned int spotNum;
+	float step;
+	unsigned int spotIdx;
+	unsigned int spotEnd;
+	unsigned int segmentIdx;
+};
+
+// the transform putting an object's x, y and z axes along side, up and
+// forward at the spot, uniformly scaled
+glm::mat4 spotTransform(const TrackSpot& spot, float scale);
+
+// one transform every spacing units: the object's x, y and z axes along
+// side, up and forward, uniformly scaled. transforms is resized once and
+// written in place, so a buffer kept between rebuilds doesn't allocate.
+// returns the number of objects placed
+unsigned int placeAlongTrack(const TrackData& track, float spacing, float scale, std::vector<glm::mat4>& transforms);
@@ -0,0 +1,205 @@
+#include "tracksamples.h"
+
+#include <algorithm>
+#include <math.h>
+
+TrackData::TrackData() {
+	TrackData::railGap = 0.0f;
+}
+
+void TrackData::assign(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& crosses,
+	const std::vector<SplineShape>& shapes, float railGap) {
+	unsigned int sampleNum = (unsigned int)positions.size();
+	TrackData::railGap = railGap;
+	blocks.resize((sampleNum + BLOCK_SIZE - 1) / BLOCK_SIZE);
+	samples.resize(sampleNum);
+	for (unsigned int blockIdx = 0; blockIdx < blocks.size(); blockIdx++)
+		encodeBlock(positions, crosses, shapes, blockIdx);
+	sumLengths();
+}
+
+void TrackData::assign(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& crosses,
+	const std::vector<SplineShape>& shapes, float railGap, const TrackData& previous, const std::vector<unsigned char>& changedBlocks) {
+	unsigned int sampleNum = (unsigned int)positions.size();
+	TrackData::railGap = railGap;
+	blocks.resize((sampleNum + BLOCK_SIZE - 1) / BLOCK_SIZE);
+	samples.resize(sampleNum);
+	for (unsigned int blockIdx = 0; blockIdx < blocks.size(); blockIdx++) {
+		if (changedBlocks[blockIdx]) {
+			encodeBlock(positions, crosses, shapes, blockIdx);
+			continue;
+		}
+		unsigned int beg = blockIdx * BLOCK_SIZE;
+		unsigned int end = (beg + BLOCK_SIZE < sampleNum) ? beg + BLOCK_SIZE : sampleNum;
+		blocks[blockIdx] = previous.blocks[blockIdx];
+		std::copy(previous.samples.begin() + beg, previous.samples.begin() + end, samples.begin() + beg);
+	}
+	sumLengths();
+}
+
+void TrackData::encodeBlock(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& crosses,
+	const std::vector<SplineShape>& shapes, unsigned int blockIdx) {
+	unsigned int sampleNum = (unsigned int)positions.size();
+	unsigned int beg = blockIdx * BLOCK_SIZE;
+	unsigned int end = (beg + BLOCK_SIZE < sampleNum) ? beg + BLOCK_SIZE : sampleNum;
+	// the block's bounding box: origin in its middle, step so the
+	// farthest corner just fits the 16 bits
+	glm::vec3 lo = positions[beg], hi = positions[beg];
+	for (unsigned int i = beg + 1; i < end; i++) {
+		lo = glm::min(lo, positions[i]);
+		hi = glm::max(hi, positions[i]);
+	}
+	Block& block = blocks[blockIdx];
+	block.origin = 0.5f * (lo + hi);
+	glm::vec3 half = 0.5f * (hi - lo);
+	float extent = fmaxf(half.x, fmaxf(half.y, half.z));
+	block.step = (extent > 0.0f) ? extent / 32767.0f : 1.0f;
+	// the curvature in the frame the decoded tangent and cross give, so
+	// curvature() puts it back the same way
+	glm::vec2 bends[BLOCK_SIZE];
+	float bendMax = 0.0f;
+	for (unsigned int i = beg; i < end; i++) {
+		glm::vec3 offset = (positions[i] - block.origin) / block.step;
+		for (int axis = 0; axis < 3; axis++)
+			samples[i].offset[axis] = (short)fmaxf(-32767.0f, fminf(32767.0f, roundf(offset[axis])));
+		encodeUnit(crosses[i], samples[i].cross);
+		// a spline stopped dead has no direction, take the next sample's
+		glm::vec3 tangent = shapes[i].tangent;
+		if (glm::length(tangent) <= 0.0f)
+			tangent = positions[(i + 1) % sampleNum] - positions[i];
+		encodeUnit(tangent, samples[i].tangent);
+		glm::vec3 up, side;
+		frame(decodeUnit(samples[i].tangent), decodeUnit(samples[i].cross), up, side);
+		bends[i - beg] = glm::vec2(glm::dot(shapes[i].curvature, up), glm::dot(shapes[i].curvature, side));
+		bendMax = fmaxf(bendMax, fmaxf(fabsf(bends[i - beg].x), fabsf(bends[i - beg].y)));
+	}
+	block.bendStep = (bendMax > 0.0f) ? bendMax / 32767.0f : 1.0f;
+	for (unsigned int i = beg; i < end; i++) {
+		samples[i].bend[0] = (short)roundf(bends[i - beg].x / block.bendStep);
+		samples[i].bend[1] = (short)roundf(bends[i - beg].y / block.bendStep);
+	}
+}
+
+// on the decoded positions, every sample again: everything after a change
+// moves along
+void TrackData::sumLengths() {
+	unsigned int sampleNum = (unsigned int)samples.size();
+	runningLength.resize(sampleNum);
+	float total = 0.0f;
+	for (unsigned int i = 0; i < sampleNum; i++) {
+		total += glm::length(direct(i));
+		runningLength[i] = total;
+	}
+}
+
+unsigned int TrackData::size() const {
+	return (unsigned int)samples.size();
+}
+
+bool TrackData::empty() const {
+	return samples.empty();
+}
+
+glm::vec3 TrackData::position(unsigned int idx) const {
+	const Block& block = blocks[idx / BLOCK_SIZE];
+	const short* offset = samples[idx].offset;
+	return block.origin + block.step * glm::vec3((float)offset[0], (float)offset[1], (float)offset[2]);
+}
+
+glm::vec3 TrackData::direct(unsigned int idx) const {
+	return position((idx + 1) % samples.size()) - position(idx);
+}
+
+glm::vec3 TrackData::cross(unsigned int idx) const {
+	return decodeUnit(samples[idx].cross);
+}
+
+glm::vec3 TrackData::tangent(unsigned int idx) const {
+	return decodeUnit(samples[idx].tangent);
+}
+
+glm::vec3 TrackData::up(unsigned int idx) const {
+	glm::vec3 up, side;
+	frame(tangent(idx), cross(idx), up, side);
+	return up;
+}
+
+glm::vec3 TrackData::curvature(unsigned int idx) const {
+	const Block& block = blocks[idx / BLOCK_SIZE];
+	glm::vec3 up, side;
+	frame(tangent(idx), cross(idx), up, side);
+	return block.bendStep * ((float)samples[idx].bend[0] * up + (float)samples[idx].bend[1] * side);
+}
+
+glm::vec3 TrackData::tangentAt(unsigned int idx, float distance) const {
+	return glm::normalize(tangent(idx) + distance * curvature(idx));
+}
+
+glm::vec3 TrackData::leftRail(unsigned int idx) const {
+	return position(idx) - 0.5f * railGap * cross(idx);
+}
+
+glm::vec3 TrackData::rightRail(unsigned int idx) const {
+	return position(idx) + 0.5f * railGap * cross(idx);
+}
+
+const std::vector<float>& TrackData::lengths() const {
+	return runningLength;
+}
+
+float TrackData::length(unsigned int idx) const {
+	return runningLength[idx];
+}
+
+float TrackData::trackLength() const {
+	return runningLength.empty() ? 0.0f : runningLength.back();
+}
+
+size_t TrackData::memoryUsed() const {
+	return blocks.size() * sizeof(Block) + samples.size() * sizeof(Sample) + runningLength.size() * sizeof(float);
+}
+
+// fold the unit sphere onto the |x|+|y|+|z| = 1 octahedron, then the lower
+// half over the upper one, which leaves a square
+void TrackData::encodeUnit(const glm::vec3& v, short code[2]) {
+	float sum = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+	if (sum <= 0.0f) {
+		code[0] = 0;
+		code[1] = 0;
+		return;
+	}
+	float x = v.x / sum, y = v.y / sum;
+	if (v.z < 0.0f) {
+		float foldX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldX;
+		y = foldY;
+	}
+	code[0] = (short)roundf(fmaxf(-1.0f, fminf(1.0f, x)) * 32767.0f);
+	code[1] = (short)roundf(fmaxf(-1.0f, fminf(1.0f, y)) * 32767.0f);
+}
+
+glm::vec3 TrackData::decodeUnit(const short code[2]) {
+	float x = code[0] / 32767.0f, y = code[1] / 32767.0f;
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	if (z < 0.0f) {
+		float unfoldX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float unfoldY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = unfoldX;
+		y = unfoldY;
+	}
+	return glm::normalize(glm::vec3(x, y, z));
+}
+
+void TrackData::frame(const glm::vec3& tangent, const glm::vec3& cross, glm::vec3& up, glm::vec3& side) {
+	up = -glm::cross(tangent, cross);
+	float length = glm::length(up);
+	// a cross vector along the track leaves no plane for the rails
+	if (length <= 0.0f) {
+		up = glm::vec3(0.0f);
+		side = glm::vec3(0.0f);
+		return;
+	}
+	up /= length;
+	side = glm::normalize(glm::cross(tangent, up));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "splinekernel.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// The samples the train runs on, stored small enough that tracks of a
+// million samples stay cheap to keep around and to share.
+// Positions are split into blocks of BLOCK_SIZE samples; a block keeps one
+// origin and one step, its samples only 16 bit offsets from that origin.
+// The cross vectors and the spline's tangents are unit vectors packed into
+// two 16 bit numbers each (octahedral encoding). The curvature is kept as
+// its parts along the sample's up and side, in 16 bit steps of a scale the
+// block keeps like the position step. The torsion isn't kept, nothing
+// running on the track needs it.
+// Nothing else is kept: the direction to the next sample is the difference
+// of the decoded positions, and the rails are the center moved half the
+// rail gap along the cross vector. The running lengths are measured on the
+// decoded positions so everything agrees.
+// Never changed once built, the view and the simulation thread share it.
+class TrackData {
+public:
+	enum { BLOCK_SIZE = 64 };
+	TrackData();
+	// encode the samples. crosses doesn't need to be unit length, shapes
+	// are the spline's derivatives at the samples
+	void assign(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& crosses,
+		const std::vector<SplineShape>& shapes, float railGap);
+	// the same, but the blocks not flagged in changedBlocks are copied from
+	// previous, which was assigned the same samples there
+	void assign(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& crosses,
+		const std::vector<SplineShape>& shapes, float railGap,
+		const TrackData& previous, const std::vector<unsigned char>& changedBlocks);
+
+	unsigned int size() const;
+	bool empty() const;
+	glm::vec3 position(unsigned int idx) const;
+	// from this sample to the next one, the last one loops to the first
+	glm::vec3 direct(unsigned int idx) const;
+	glm::vec3 cross(unsigned int idx) const;
+	// the spline's own direction at the sample, unit length
+	glm::vec3 tangent(unsigned int idx) const;
+	// away from the rails' plane, square to the tangent
+	glm::vec3 up(unsigned int idx) const;
+	// toward the middle of the turn, 1/radius long
+	glm::vec3 curvature(unsigned int idx) const;
+	// the tangent at distance along from the sample: it turns with the
+	// curvature, so it stays smooth between samples and straight on a
+	// straight line
+	glm::vec3 tangentAt(unsigned int idx, float distance) const;
+	glm::vec3 leftRail(unsigned int idx) const;
+	glm::vec3 rightRail(unsigned int idx) const;
+	// running length at the end of each sample
+	const std::vector<float>& lengths() const;
+	float length(unsigned int idx) const;
+	float trackLength() const;
+	// bytes held by the samples
+	size_t memoryUsed() const;
+private:
+	// writes and loads the packed storage as it is
+	friend class TrackBundle;
+	struct Block {
+		glm::vec3 origin;
+		float step;
+		float bendStep;		// of the curvature
+	};
+	struct Sample {
+		short offset[3];	// times the block's step, from its origin
+		short cross[2];		// octahedral
+		short tangent[2];	// octahedral
+		short bend[2];		// curvature along up and side, times bendStep
+	};
+	void encodeBlock(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& crosses,
+		const std::vector<SplineShape>& shapes, unsigned int blockIdx);
+	void sumLengths();
+	static void encodeUnit(const glm::vec3& v, short code[2]);
+	static glm::vec3 decodeUnit(const short code[2]);
+	// up and side of a tangent and a cross vector
+	static void frame(const glm::vec3& tangent, const glm::vec3& cross, glm::vec3& up, glm::vec3& side);
+
+	std::vector<Block> blocks;
+	std::vector<Sample> samples;
+	std::vector<float> runningLength;
+	float railGap;
+};
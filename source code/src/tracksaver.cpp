@@ -0,0 +1,90 @@
+#include "tracksaver.h"
+
+#include "Track.H"
+
+TrackSaver::TrackSaver() {
+	TrackSaver::writing = false;
+	TrackSaver::stopping = false;
+	TrackSaver::doneCallback = NULL;
+	TrackSaver::doneData = NULL;
+}
+
+TrackSaver::~TrackSaver() {
+	TrackSaver::setDoneCallback(NULL, NULL);
+	TrackSaver::stop();
+}
+
+void TrackSaver::stop() {
+	{
+		std::lock_guard<std::mutex> guard(TrackSaver::lock);
+		TrackSaver::stopping = true;
+	}
+	TrackSaver::jobReady.notify_all();
+	if (TrackSaver::worker.joinable())
+		TrackSaver::worker.join();
+	TrackSaver::stopping = false;
+}
+
+void TrackSaver::save(const std::string& fileName, Snapshot points) {
+	{
+		std::lock_guard<std::mutex> guard(TrackSaver::lock);
+		Job* job = NULL;
+		for (unsigned int i = 0; i < TrackSaver::jobs.size() && job == NULL; i++)
+			if (TrackSaver::jobs[i].fileName == fileName) job = &TrackSaver::jobs[i];
+		if (job == NULL) {
+			TrackSaver::jobs.push_back(Job());
+			job = &TrackSaver::jobs.back();
+			job->fileName = fileName;
+		}
+		job->points = points;
+		if (!TrackSaver::worker.joinable())
+			TrackSaver::worker = std::thread(&TrackSaver::workerLoop, this);
+	}
+	TrackSaver::jobReady.notify_one();
+}
+
+bool TrackSaver::busy() {
+	std::lock_guard<std::mutex> guard(TrackSaver::lock);
+	return !TrackSaver::jobs.empty() || TrackSaver::writing;
+}
+
+bool TrackSaver::takeResult(std::string& fileName, bool& ok) {
+	std::lock_guard<std::mutex> guard(TrackSaver::lock);
+	if (TrackSaver::done.empty()) return false;
+	fileName = TrackSaver::done.front().fileName;
+	ok = TrackSaver::done.front().ok;
+	TrackSaver::done.erase(TrackSaver::done.begin());
+	return true;
+}
+
+void TrackSaver::setDoneCallback(void (*callback)(void*), void* data) {
+	std::lock_guard<std::mutex> guard(TrackSaver::lock);
+	TrackSaver::doneCallback = callback;
+	TrackSaver::doneData = data;
+}
+
+// when stopping, the queued saves are still written: they are the user's
+// work, unlike a track build nobody waits for any more
+void TrackSaver::workerLoop() {
+	while (1) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> guard(TrackSaver::lock);
+			TrackSaver::writing = false;
+			while (!TrackSaver::stopping && TrackSaver::jobs.empty())
+				TrackSaver::jobReady.wait(guard);
+			if (TrackSaver::jobs.empty()) return;
+			job = TrackSaver::jobs.front();
+			TrackSaver::jobs.erase(TrackSaver::jobs.begin());
+			TrackSaver::writing = true;
+		}
+
+		job.ok = CTrack::writePoints(job.fileName.c_str(), *job.points);
+		job.points.reset();
+
+		std::lock_guard<std::mutex> guard(TrackSaver::lock);
+		TrackSaver::done.push_back(job);
+		if (TrackSaver::doneCallback != NULL)
+			TrackSaver::doneCallback(TrackSaver::doneData);
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ControlPoint.H"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Writes control points to disk on a thread of its own, so saving a long
+// track never holds up the UI. save() takes a snapshot nobody changes any
+// more; a save still queued for the same file is replaced, only the newest
+// points matter. Each file is written to a temporary one and renamed over
+// the old one when complete (CTrack::writePoints).
+class TrackSaver {
+public:
+	typedef std::shared_ptr<const std::vector<ControlPoint> > Snapshot;
+public:
+	TrackSaver();
+	// writes what is still queued before returning
+	~TrackSaver();
+	void save(const std::string& fileName, Snapshot points);
+	// true while saves are queued or being written
+	bool busy();
+	// a finished save (UI thread), false when there are no more
+	bool takeResult(std::string& fileName, bool& ok);
+	// called on the worker thread after every save, with the saver locked:
+	// once it is reset the worker doesn't call the old one any more
+	void setDoneCallback(void (*callback)(void*), void* data);
+	// write what is still queued and join the worker, the next save()
+	// starts it again
+	void stop();
+private:
+	void workerLoop();
+private:
+	struct Job {
+		std::string fileName;
+		Snapshot points;
+		bool ok;
+	};
+	std::mutex lock;
+	std::condition_variable jobReady;
+	std::vector<Job> jobs;
+	std::vector<Job> done;
+	bool writing;
+	bool stopping;
+	void (*doneCallback)(void*);
+	void* doneData;
+	std::thread worker;
+private:
+	TrackSaver(const TrackSaver&);
+	TrackSaver& operator=(const TrackSaver&);
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+
+// Hands values from one writer thread to one reader thread without locks.
+// There are three slots: the writer owns one, the reader owns one and the
+// third sits in the middle holding the newest finished value. publish() and
+// acquire() swap the caller's slot with the middle one in one atomic
+// exchange, so neither side ever waits for the other, and the reader always
+// gets the newest value (older ones the reader never saw are dropped).
+template <class T>
+class TripleBuffer {
+private:
+	enum { INDEX_MASK = 3, FRESH = 4 };	// FRESH: middle slot not read yet
+	T slots[3];
+	std::atomic<unsigned int> middle;
+	unsigned int writeIdx;	// writer only
+	unsigned int readIdx;	// reader only
+public:
+	TripleBuffer() : middle(1), writeIdx(0), readIdx(2) {}
+	// the slot to fill, it may hold an old value
+	T& writeSlot() { return slots[writeIdx]; }
+	// make the filled slot the newest value
+	void publish() {
+		writeIdx = middle.exchange(writeIdx | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+	// take the newest value if there is one, returns false if nothing was
+	// published since the last call
+	bool acquire() {
+		if ((middle.load(std::memory_order_acquire) & FRESH) == 0) return false;
+		readIdx = middle.exchange(readIdx, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+	// the value taken by the last acquire(), the reader may use it freely
+	T& readSlot() { return slots[readIdx]; }
+private:
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator=(const TripleBuffer&);
+};